@@ -0,0 +1,3 @@
+#include "arena.hpp"
+
+thread_local std::pmr::memory_resource* statement_arena = nullptr;
@@ -0,0 +1,25 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+// Memory for the temporaries of the statement SqlInterpreter::execute is running
+// (expression trees, plan nodes, join bookkeeping), handed out from a monotonic
+// arena that is released in one go when the statement is done. Null otherwise, so
+// prepared statements, whose trees and plans outlive any one execution, use the heap.
+extern thread_local std::pmr::memory_resource* statement_arena;
+
+inline std::pmr::memory_resource* temp_memory() {
+    return statement_arena ? statement_arena : std::pmr::new_delete_resource();
+}
+
+// make_shared for statement temporaries: the object and its reference count go
+// to temp_memory(), so nothing made this way may outlive the statement.
+template <typename T, typename... Args>
+std::shared_ptr<T> make_temp(Args&&... args) {
+    return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(temp_memory()), std::forward<Args>(args)...);
+}
+
+#endif
@@ -0,0 +1,316 @@
+#include "bench.hpp"
+#include "sql_handle.hpp"
+#include "csv_manip.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/resource.h>
+
+namespace fs = std::filesystem;
+
+static const char* BENCH_DB = "bench_db";
+static const char* BENCH_CSV = "bench_dump.csv";
+
+std::string BenchDataGenerator::create_sql(std::string table) {
+    std::string sql = "CREATE TABLE " + table + " (id INTEGER PRIMARY KEY";
+    for (size_t c = 0; c < spec.types.size(); c++) {
+        std::string type = datatype_to_string(spec.types[c]);
+        if (spec.types[c] == DataType::DECIMAL) type += "(12,2)";
+        sql += ", c" + std::to_string(c) + " " + type;
+    }
+    return sql + ");";
+}
+
+// Values are derived from the raw engine output rather than through <random>
+// distributions, whose results differ between standard libraries.
+std::string BenchDataGenerator::value(DataType type) {
+    uint64_t bits = random();
+    char text[32];
+    switch (type) {
+        case DataType::INTEGER: return std::to_string(bits % 1000000);
+        case DataType::BIGINT: return std::to_string(5000000000 + bits % 1000000000);
+        case DataType::FLOAT: {
+            double value = double(bits >> 11) * 0x1.0p-53 * 1000;
+            auto end = std::to_chars(text, text + sizeof(text), value, std::chars_format::fixed, 3).ptr;
+            return std::string(text, end);
+        }
+        case DataType::DECIMAL: {
+            uint64_t cents = bits % 10000000000;
+            std::string fraction = std::to_string(cents % 100);
+            return std::to_string(cents / 100) + "." + (fraction.size() < 2 ? "0" : "") + fraction;
+        }
+        case DataType::TEXT: break;
+    }
+    return "'v" + std::to_string(bits % std::max<size_t>(1, spec.text_cardinality)) + "'";
+}
+
+std::string BenchDataGenerator::row(size_t id) {
+    std::string result = "(" + std::to_string(id);
+    for (auto type : spec.types) result += ", " + value(type);
+    return result + ")";
+}
+
+std::vector<std::string> BenchDataGenerator::inserts(std::string table, size_t first_id, size_t count, size_t batch) {
+    std::vector<std::string> statements;
+    for (size_t done = 0; done < count; done += batch) {
+        std::string sql = "INSERT INTO " + table + " VALUES ";
+        for (size_t i = done; i < std::min(count, done + batch); i++) {
+            if (i > done) sql += ", ";
+            sql += row(first_id + i);
+        }
+        statements.push_back(sql + ";");
+    }
+    return statements;
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// One benchmark at one table size: a latency per timed call plus the rows the
+// calls touched in total.
+struct BenchResult {
+    std::string name;
+    size_t table_rows = 0;
+    size_t rows = 0;
+    std::vector<double> latencies_us;
+    long peak_rss_kb = 0;
+};
+
+class BenchRun {
+public:
+    std::vector<BenchResult> results;  // the last one is being measured
+
+    void start(std::string name, size_t table_rows) {
+        std::cerr << "  " << name << "...\n";
+        results.push_back({name, table_rows, 0, {}, 0});
+    }
+
+    template <typename F>
+    void time(size_t rows, F&& work) {
+        auto begin = Clock::now();
+        work();
+        auto& current = results.back();
+        current.latencies_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+        current.rows += rows;
+        current.peak_rss_kb = peak_rss_kb();
+    }
+
+    void sql(SqlInterpreter& interpreter, std::string statement, size_t rows) {
+        time(rows, [&] { interpreter.execute(statement); });
+    }
+};
+
+double percentile(std::vector<double> sorted, double p) {
+    if (sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))];
+}
+
+void write_json(std::ostream& out, BenchTableSpec spec, std::vector<BenchResult>& results) {
+    out << "{\n  \"spec\": {\"types\": [";
+    for (size_t i = 0; i < spec.types.size(); i++) {
+        out << (i ? ", " : "") << '"' << datatype_to_string(spec.types[i]) << '"';
+    }
+    out << "], \"text_cardinality\": " << spec.text_cardinality << ", \"seed\": " << spec.seed << "},\n";
+    out << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        std::vector<double> sorted = r.latencies_us;
+        std::sort(sorted.begin(), sorted.end());
+        double seconds = 0;
+        for (double us : sorted) seconds += us / 1e6;
+        out << (i ? "," : "") << "\n    {\"benchmark\": \"" << r.name << "\", \"table_rows\": " << r.table_rows
+            << ", \"iterations\": " << sorted.size() << ", \"rows\": " << r.rows << ", \"seconds\": " << seconds
+            << ", \"ops_per_sec\": " << (seconds > 0 ? sorted.size() / seconds : 0)
+            << ", \"rows_per_sec\": " << (seconds > 0 ? r.rows / seconds : 0)
+            << ", \"latency_us\": {\"p50\": " << percentile(sorted, 0.5) << ", \"p95\": " << percentile(sorted, 0.95)
+            << ", \"p99\": " << percentile(sorted, 0.99) << ", \"max\": " << (sorted.empty() ? 0 : sorted.back())
+            << "}, \"peak_rss_kb\": " << r.peak_rss_kb << "}";
+    }
+    out << "\n  ],\n  \"peak_rss_kb\": " << peak_rss_kb() << "\n}\n";
+}
+
+void drop_bench_database() {
+    if (fs::exists(fs::path("./dbs") / BENCH_DB)) DiskStorage().delete_database(BENCH_DB);
+    fs::remove(BENCH_CSV);
+}
+
+size_t parse_count(std::string text) {
+    double value = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || end != text.data() + text.size() || value < 1) {
+        throw std::runtime_error("Invalid count: " + text);
+    }
+    return size_t(value);
+}
+
+// any unsigned 64-bit value, 0 included
+uint64_t parse_seed(std::string text) {
+    uint64_t value = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || end != text.data() + text.size()) throw std::runtime_error("Invalid seed: " + text);
+    return value;
+}
+
+std::vector<std::string> split_list(std::string text) {
+    std::vector<std::string> items;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) items.push_back(item);
+    return items;
+}
+
+void bench_table_size(BenchRun& run, BenchTableSpec spec) {
+    size_t n = spec.rows;
+    BenchDataGenerator gen(spec);
+    drop_bench_database();
+
+    {
+        SqlInterpreter interpreter;
+        interpreter.execute("CREATE DATABASE " + std::string(BENCH_DB) + "; USE DATABASE " + BENCH_DB + ";");
+        interpreter.execute(gen.create_sql("t"));
+
+        run.start("insert", n);
+        auto inserts = gen.inserts("t", 0, n, 1000);
+        for (size_t i = 0; i < inserts.size(); i++) {
+            run.sql(interpreter, inserts[i], std::min<size_t>(n - i * 1000, 1000));
+        }
+
+        run.start("point_select", n);
+        for (int i = 0; i < 1000; i++) {
+            run.sql(interpreter, "SELECT * FROM t WHERE id = " + std::to_string(gen.random() % n) + ";", 1);
+        }
+
+        // about a tenth of the table per query: on an INTEGER column when there is one, else on the key
+        auto integer = std::find(spec.types.begin(), spec.types.end(), DataType::INTEGER);
+        run.start("range_scan", n);
+        for (int i = 0; i < 20; i++) {
+            std::string range;
+            if (integer != spec.types.end()) {
+                auto low = gen.random() % 900000;
+                std::string column = "c" + std::to_string(integer - spec.types.begin());
+                range = column + " >= " + std::to_string(low) + " AND " + column + " < " + std::to_string(low + 100000);
+            } else {
+                auto low = gen.random() % n;
+                range = "id >= " + std::to_string(low) + " AND id < " + std::to_string(low + n / 10 + 1);
+            }
+            run.sql(interpreter, "SELECT id FROM t WHERE " + range + ";", n);
+        }
+
+        size_t span = std::max<size_t>(1, n / 100);
+        run.start("update", n);
+        for (int i = 0; i < 20 && !spec.types.empty(); i++) {
+            auto low = gen.random() % n;
+            run.sql(interpreter, "UPDATE t SET c0 = " + gen.value(spec.types[0]) + " WHERE id >= " + std::to_string(low) +
+                    " AND id < " + std::to_string(low + span) + ";", span);
+        }
+
+        span = std::max<size_t>(1, n / 1000);
+        run.start("delete", n);
+        for (int i = 0; i < 10; i++) {
+            auto low = gen.random() % n;
+            run.sql(interpreter, "DELETE FROM t WHERE id >= " + std::to_string(low) + " AND id < " +
+                    std::to_string(low + span) + ";", span);
+        }
+
+        size_t remaining = interpreter.current_db->get_table("t").rows->size();
+        run.start("csv_dump", n);
+        run.sql(interpreter, "COPY t TO '" + std::string(BENCH_CSV) + "';", remaining);
+        interpreter.execute(gen.create_sql("t_copy"));
+        run.start("csv_load", n);
+        run.sql(interpreter, "COPY t_copy FROM '" + std::string(BENCH_CSV) + "';", remaining);
+
+        // the join runs on its own pair of tables, capped in size while joins pair every row
+        size_t join_rows = std::min<size_t>(n, 1000);
+        interpreter.execute("CREATE TABLE l (id INTEGER PRIMARY KEY, ref INTEGER); CREATE TABLE r (id INTEGER PRIMARY KEY, label TEXT);");
+        std::string left = "INSERT INTO l VALUES ", right = "INSERT INTO r VALUES ";
+        for (size_t i = 0; i < join_rows; i++) {
+            left += (i ? ", (" : "(") + std::to_string(i) + ", " + std::to_string(gen.random() % join_rows) + ")";
+            right += (i ? ", (" : "(") + std::to_string(i) + ", " + gen.value(DataType::TEXT) + ")";
+        }
+        interpreter.execute(left + "; " + right + ";");
+        run.start("join", join_rows);
+        for (int i = 0; i < 5; i++) {
+            run.sql(interpreter, "SELECT l.id, r.label FROM l INNER JOIN r ON l.ref = r.id;", join_rows);
+        }
+
+        run.start("save", n);
+        run.time(remaining, [&] { interpreter.close_database(); });
+    }
+
+    run.start("use_database", n);
+    for (int i = 0; i < 3; i++) {
+        SqlInterpreter interpreter;
+        run.time(n, [&] { interpreter.execute("USE DATABASE " + std::string(BENCH_DB) + ";"); });
+        interpreter.current_db = nullptr;  // nothing changed; skip the save on destruction
+    }
+    drop_bench_database();
+}
+
+}
+
+int run_benchmarks(int argc, char* argv[]) {
+    try {
+        BenchTableSpec spec;
+        std::vector<size_t> sizes = {1000, 10000, 100000, 1000000};
+        std::string out_path;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) throw std::runtime_error("Missing value after " + arg);
+            std::string value = argv[++i];
+            if (arg == "--rows") {
+                sizes.clear();
+                for (auto& item : split_list(value)) sizes.push_back(parse_count(item));
+            } else if (arg == "--types") {
+                spec.types.clear();
+                for (auto& item : split_list(value)) {
+                    auto type = string_to_datatype(item);
+                    if (datatype_to_string(type) != item) throw std::runtime_error("Unknown column type: " + item);
+                    spec.types.push_back(type);
+                }
+            } else if (arg == "--text-cardinality") {
+                spec.text_cardinality = parse_count(value);
+            } else if (arg == "--seed") {
+                spec.seed = parse_seed(value);
+            } else if (arg == "--out") {
+                out_path = value;
+            } else {
+                throw std::runtime_error("Unknown bench option " + arg);
+            }
+        }
+
+        BenchRun run;
+        for (auto n : sizes) {
+            std::cerr << "bench: " << n << " rows\n";
+            spec.rows = n;
+            bench_table_size(run, spec);
+        }
+
+        if (out_path.empty()) {
+            write_json(std::cout, spec, run.results);
+        } else {
+            std::ofstream out(out_path);
+            if (!out) throw std::runtime_error("Could not open " + out_path);
+            write_json(out, spec, run.results);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        drop_bench_database();
+        return 1;
+    }
+    return 0;
+}
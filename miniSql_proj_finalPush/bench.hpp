@@ -0,0 +1,41 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "celldata.hpp"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Shape of a synthetic table: an INTEGER PRIMARY KEY `id` followed by columns
+// c0, c1, ... of the given types.
+struct BenchTableSpec {
+    size_t rows = 1000;
+    std::vector<DataType> types = {DataType::INTEGER, DataType::FLOAT, DataType::TEXT};
+    size_t text_cardinality = 100;  // distinct values in each TEXT column
+    uint64_t seed = 42;
+};
+
+// Deterministic row source: the same spec always produces the same values, so
+// runs of different builds measure the same work.
+class BenchDataGenerator {
+public:
+    BenchTableSpec spec;
+    std::mt19937_64 random;
+
+    BenchDataGenerator(BenchTableSpec spec) : spec(spec), random(spec.seed) {}
+
+    std::string create_sql(std::string table);
+    std::string value(DataType type);   // one SQL literal
+    std::string row(size_t id);         // "(id, c0, c1, ...)"
+    // INSERT statements of up to `batch` rows each, with ids first_id, first_id+1, ...
+    std::vector<std::string> inserts(std::string table, size_t first_id, size_t count, size_t batch);
+};
+
+// `bench` mode of main: runs the microbenchmarks and prints (or writes) JSON.
+//   bench [--rows 1000,10000,...] [--types INTEGER,FLOAT,TEXT] [--text-cardinality N]
+//         [--seed N] [--out results.json]
+// Without --rows it runs 1000, 10000, 100000 and 1000000 rows.
+int run_benchmarks(int argc, char* argv[]);
+
+#endif
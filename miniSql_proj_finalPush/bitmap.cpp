@@ -0,0 +1,210 @@
+#include "bitmap.hpp"
+#include <algorithm>
+#include <bit>
+#include <iterator>
+
+bool Bitmap::Container::contains(uint16_t low) const {
+    if (dense()) return (bits[low >> 6] >> (low & 63)) & 1;
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+void Bitmap::Container::add(uint16_t low) {
+    if (dense()) {
+        uint64_t mask = uint64_t(1) << (low & 63);
+        if (bits[low >> 6] & mask) return;
+        bits[low >> 6] |= mask;
+        cardinality++;
+        return;
+    }
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it != array.end() && *it == low) return;
+    array.insert(it, low);
+    cardinality++;
+    if (cardinality > ARRAY_LIMIT) to_dense();
+}
+
+void Bitmap::Container::remove(uint16_t low) {
+    if (dense()) {
+        uint64_t mask = uint64_t(1) << (low & 63);
+        if (!(bits[low >> 6] & mask)) return;
+        bits[low >> 6] &= ~mask;
+        cardinality--;
+        if (cardinality < SPARSE_LIMIT) to_sparse();
+        return;
+    }
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it == array.end() || *it != low) return;
+    array.erase(it);
+    cardinality--;
+}
+
+void Bitmap::Container::to_dense() {
+    bits.assign(WORDS, 0);
+    for (auto low : array) bits[low >> 6] |= uint64_t(1) << (low & 63);
+    array.clear();
+    array.shrink_to_fit();
+}
+
+void Bitmap::Container::to_sparse() {
+    array.clear();
+    array.reserve(cardinality);
+    for (size_t w = 0; w < WORDS; w++) {
+        for (uint64_t word = bits[w]; word; word &= word - 1) {
+            array.push_back(uint16_t(w * 64 + std::countr_zero(word)));
+        }
+    }
+    bits.clear();
+    bits.shrink_to_fit();
+}
+
+void Bitmap::add(size_t id) {
+    uint32_t key = uint32_t(id >> 16);
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint32_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key) {
+        Container container;
+        container.key = key;
+        it = containers.insert(it, container);
+    }
+    it->add(uint16_t(id & 0xFFFF));
+}
+
+void Bitmap::remove(size_t id) {
+    uint32_t key = uint32_t(id >> 16);
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint32_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key) return;
+    it->remove(uint16_t(id & 0xFFFF));
+    if (it->cardinality == 0) containers.erase(it);
+}
+
+void Bitmap::close_gaps(const std::vector<size_t>& removed) {
+    if (removed.empty()) return;
+    auto from = std::lower_bound(containers.begin(), containers.end(), uint32_t(removed.front() >> 16),
+                                 [](const Container& c, uint32_t k) { return c.key < k; });
+    if (from == containers.end()) return;
+    Bitmap tail;
+    tail.containers.assign(std::make_move_iterator(from), std::make_move_iterator(containers.end()));
+    containers.erase(from, containers.end());
+    for (auto id : tail.ids()) add(id - (std::lower_bound(removed.begin(), removed.end(), id) - removed.begin()));
+}
+
+bool Bitmap::contains(size_t id) const {
+    uint32_t key = uint32_t(id >> 16);
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint32_t k) { return c.key < k; });
+    return it != containers.end() && it->key == key && it->contains(uint16_t(id & 0xFFFF));
+}
+
+size_t Bitmap::cardinality() const {
+    size_t total = 0;
+    for (auto& c : containers) total += c.cardinality;
+    return total;
+}
+
+std::vector<size_t> Bitmap::ids() const {
+    std::vector<size_t> result;
+    result.reserve(cardinality());
+    for (auto& c : containers) {
+        size_t base = size_t(c.key) << 16;
+        if (!c.dense()) {
+            for (auto low : c.array) result.push_back(base | low);
+            continue;
+        }
+        for (size_t w = 0; w < WORDS; w++) {
+            for (uint64_t word = c.bits[w]; word; word &= word - 1) {
+                result.push_back(base | (w * 64 + std::countr_zero(word)));
+            }
+        }
+    }
+    return result;
+}
+
+Bitmap operator&(const Bitmap& a, const Bitmap& b) {
+    Bitmap result;
+    auto i = a.containers.begin(), j = b.containers.begin();
+    while (i != a.containers.end() && j != b.containers.end()) {
+        if (i->key < j->key) { ++i; continue; }
+        if (j->key < i->key) { ++j; continue; }
+
+        Bitmap::Container c;
+        c.key = i->key;
+        if (i->dense() && j->dense()) {
+            c.bits.resize(Bitmap::WORDS);
+            for (size_t w = 0; w < Bitmap::WORDS; w++) {
+                c.bits[w] = i->bits[w] & j->bits[w];
+                c.cardinality += std::popcount(c.bits[w]);
+            }
+            if (c.cardinality <= Bitmap::ARRAY_LIMIT) c.to_sparse();
+        } else if (!i->dense() && !j->dense()) {
+            std::set_intersection(i->array.begin(), i->array.end(), j->array.begin(), j->array.end(),
+                                  std::back_inserter(c.array));
+            c.cardinality = c.array.size();
+        } else {
+            auto& sparse = i->dense() ? *j : *i;
+            auto& dense = i->dense() ? *i : *j;
+            for (auto low : sparse.array) {
+                if (dense.contains(low)) c.array.push_back(low);
+            }
+            c.cardinality = c.array.size();
+        }
+        if (c.cardinality > 0) result.containers.push_back(std::move(c));
+        ++i;
+        ++j;
+    }
+    return result;
+}
+
+Bitmap operator|(const Bitmap& a, const Bitmap& b) {
+    Bitmap result;
+    auto i = a.containers.begin(), j = b.containers.begin();
+    while (i != a.containers.end() || j != b.containers.end()) {
+        if (j == b.containers.end() || (i != a.containers.end() && i->key < j->key)) {
+            result.containers.push_back(*i++);
+            continue;
+        }
+        if (i == a.containers.end() || j->key < i->key) {
+            result.containers.push_back(*j++);
+            continue;
+        }
+
+        Bitmap::Container c;
+        if (i->dense() && j->dense()) {
+            c.key = i->key;
+            c.bits.resize(Bitmap::WORDS);
+            for (size_t w = 0; w < Bitmap::WORDS; w++) {
+                c.bits[w] = i->bits[w] | j->bits[w];
+                c.cardinality += std::popcount(c.bits[w]);
+            }
+        } else if (!i->dense() && !j->dense()) {
+            c.key = i->key;
+            std::set_union(i->array.begin(), i->array.end(), j->array.begin(), j->array.end(),
+                           std::back_inserter(c.array));
+            c.cardinality = c.array.size();
+            if (c.cardinality > Bitmap::ARRAY_LIMIT) c.to_dense();
+        } else {
+            c = i->dense() ? *i : *j;
+            for (auto low : (i->dense() ? *j : *i).array) c.add(low);
+        }
+        result.containers.push_back(std::move(c));
+        ++i;
+        ++j;
+    }
+    return result;
+}
+
+void BitmapIndex::add(CellData value, size_t id) {
+    values[value].add(id);
+}
+
+void BitmapIndex::remove(CellData value, size_t id) {
+    auto it = values.find(value);
+    if (it == values.end()) return;
+    it->second.remove(id);
+    if (it->second.cardinality() == 0) values.erase(it);
+}
+
+Bitmap BitmapIndex::lookup(CellData value) const {
+    auto it = values.find(value);
+    return it == values.end() ? Bitmap() : it->second;
+}
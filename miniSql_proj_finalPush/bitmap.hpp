@@ -0,0 +1,63 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include "celldata.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Compressed set of row positions in the style of a roaring bitmap: ids are split
+// by their high 16 bits into containers that hold the low 16 bits either as a
+// sorted array (sparse) or as a 65536-bit set (dense).
+class Bitmap {
+public:
+    static constexpr size_t ARRAY_LIMIT = 4096;  // beyond this a bit set is smaller
+    // a dense container turns sparse again only well below ARRAY_LIMIT, so adds and
+    // removes around the limit don't convert back and forth
+    static constexpr size_t SPARSE_LIMIT = ARRAY_LIMIT / 2;
+    static constexpr size_t WORDS = 1024;        // 65536 bits
+
+    struct Container {
+        uint32_t key = 0;                // high bits of the ids held here
+        std::vector<uint16_t> array;     // used while sparse
+        std::vector<uint64_t> bits;      // WORDS words once dense, empty otherwise
+        size_t cardinality = 0;
+
+        bool dense() const { return !bits.empty(); }
+        bool contains(uint16_t low) const;
+        void add(uint16_t low);
+        void remove(uint16_t low);
+        void to_dense();
+        void to_sparse();
+    };
+
+    std::vector<Container> containers;  // sorted by key
+
+    void add(size_t id);
+    void remove(size_t id);
+    bool contains(size_t id) const;
+    size_t cardinality() const;
+    std::vector<size_t> ids() const;
+    // Moves each id down by the number of `removed` ids (sorted, not in the set)
+    // below it; containers before the first removed id are left alone.
+    void close_gaps(const std::vector<size_t>& removed);
+
+    friend Bitmap operator&(const Bitmap& a, const Bitmap& b);
+    friend Bitmap operator|(const Bitmap& a, const Bitmap& b);
+};
+
+// One bitmap of row positions per distinct value of a column.
+class BitmapIndex {
+public:
+    size_t column = 0;
+    std::unordered_map<CellData, Bitmap, CellDataHash, CellDataEqual> values;
+
+    BitmapIndex() = default;
+    BitmapIndex(size_t column) : column(column) {}
+
+    void add(CellData value, size_t id);
+    void remove(CellData value, size_t id);
+    Bitmap lookup(CellData value) const;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#include "bloom.hpp"
+#include <algorithm>
+
+BloomFilter::BloomFilter(size_t expected_values)
+    : words((std::max<size_t>(expected_values, 1) * BITS_PER_VALUE + 63) / 64) {}
+
+// The bits of a value are h1 + i * h2 for i < HASHES (double hashing), with both
+// halves taken from one mixed hash.
+void BloomFilter::add(const CellData& value) {
+    uint64_t h = mixed_hash(value), step = (h >> 32) | 1, bits = words.size() * 64;
+    for (size_t i = 0; i < HASHES; i++, h += step) {
+        uint64_t bit = h % bits;
+        words[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+}
+
+bool BloomFilter::may_contain(const CellData& value) const {
+    uint64_t h = mixed_hash(value), step = (h >> 32) | 1, bits = words.size() * 64;
+    for (size_t i = 0; i < HASHES; i++, h += step) {
+        uint64_t bit = h % bits;
+        if (!(words[bit / 64] & (uint64_t(1) << (bit % 64)))) return false;
+    }
+    return true;
+}
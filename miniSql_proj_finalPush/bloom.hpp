@@ -0,0 +1,23 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include "celldata.hpp"
+#include <cstdint>
+#include <vector>
+
+// Set membership with false positives but no false negatives: each value sets
+// HASHES bits chosen from its hash. About 1% false positives at the sized count.
+class BloomFilter {
+public:
+    static constexpr size_t BITS_PER_VALUE = 10;
+    static constexpr size_t HASHES = 7;
+
+    std::vector<uint64_t> words;
+
+    BloomFilter(size_t expected_values);
+
+    void add(const CellData& value);
+    bool may_contain(const CellData& value) const;
+};
+
+#endif
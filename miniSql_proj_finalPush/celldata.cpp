@@ -2,12 +2,107 @@
 #include <stdexcept>
 #include <iostream>
 #include <sstream>
+#include <charconv>
+#include <optional>
+#include <cmath>
+#include <tuple>
+#include <algorithm>
+
+// Whole-string numeric parses with from_chars: surrounding spaces and a leading
+// '+' are allowed, anything else left over means "not a number" (no exceptions).
+static std::string_view trim_number(std::string_view text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string_view::npos) return {};
+    text = text.substr(first, text.find_last_not_of(" \t\r\n") - first + 1);
+    if (text.size() > 1 && text[0] == '+' && text[1] != '-') text.remove_prefix(1);
+    return text;
+}
+
+template <typename T>
+static std::optional<T> parse_number(std::string_view text) {
+    text = trim_number(text);
+    // from_chars also reads "inf" and "nan", which are words here
+    if (text.find_first_of("iInN") != std::string_view::npos) return std::nullopt;
+    T value{};
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || end != text.data() + text.size() || text.empty()) return std::nullopt;
+    return value;
+}
+
+using int128 = __int128;
+
+static const int64_t POW10[] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL,
+    1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL, 10000000000000LL,
+    100000000000000LL, 1000000000000000LL, 10000000000000000LL, 100000000000000000LL,
+    1000000000000000000LL
+};
+
+static int128 pow10_wide(int n) {
+    int128 result = 1;
+    while (n-- > 0) result *= 10;
+    return result;
+}
+
+static int64_t narrow(int128 value) {
+    if (value > INT64_MAX || value < INT64_MIN) throw std::runtime_error("Numeric overflow");
+    return static_cast<int64_t>(value);
+}
+
+// Divides, rounding halves away from zero
+static int128 divide_rounded(int128 value, int128 divisor) {
+    int128 quotient = value / divisor, remainder = value % divisor;
+    if (remainder < 0) remainder = -remainder;
+    if (2 * remainder >= (divisor < 0 ? -divisor : divisor)) quotient += (value < 0) != (divisor < 0) ? -1 : 1;
+    return quotient;
+}
+
+// `value` counted in 10^-from units, converted to 10^-to units
+static int128 rescale(int128 value, int from, int to) {
+    if (to >= from) return value * pow10_wide(to - from);
+    return divide_rounded(value, pow10_wide(from - to));
+}
+
+// "-12.340" -> (-12340, 3); no exponent, at most 18 digits
+static std::optional<std::pair<int64_t, int>> parse_decimal(std::string_view text) {
+    text = trim_number(text);
+    bool negative = !text.empty() && text[0] == '-';
+    if (negative) text.remove_prefix(1);
+    size_t point = text.find('.');
+    std::string_view whole = text.substr(0, point);
+    std::string_view fraction = point == std::string_view::npos ? std::string_view() : text.substr(point + 1);
+    if (whole.empty() && fraction.empty()) return std::nullopt;
+    if (whole.size() + fraction.size() > size_t(CellData::MAX_DECIMAL_DIGITS)) return std::nullopt;
+    int64_t value = 0;
+    for (auto part : {whole, fraction}) {
+        for (char c : part) {
+            if (c < '0' || c > '9') return std::nullopt;
+            value = value * 10 + (c - '0');
+        }
+    }
+    return std::make_pair(negative ? -value : value, int(fraction.size()));
+}
+
+CellData CellData::bigint(int64_t value) {
+    CellData cell(DataType::BIGINT);
+    cell.data_bigint = value;
+    return cell;
+}
+
+CellData CellData::decimal(int64_t unscaled, int scale) {
+    CellData cell(DataType::DECIMAL);
+    cell.data_bigint = unscaled;
+    cell.data_scale = scale;
+    return cell;
+}
 
 CellData::CellData(DataType type) : type(type) {
     switch (type) {
         case DataType::INTEGER: data_integer = 0; break;
         case DataType::FLOAT: data_float = 0.0; break;
         case DataType::TEXT: data_text = ""; break;
+        case DataType::BIGINT:
+        case DataType::DECIMAL: break;
     }
 }
 
@@ -16,24 +111,80 @@ CellData::CellData(DataType type, std::string initializer) : type(type) {
 }
 
 void CellData::read(std::string initializer) {
-    try {
-        switch (type) {
-            case DataType::INTEGER:
-                data_integer = std::stoi(initializer);
-                break;
-            case DataType::FLOAT:
-                data_float = std::stod(initializer);
-                break;
-            case DataType::TEXT:
-                data_text = std::move(initializer);
-                break;
-        }
-    } catch (const std::exception& e) {
+    bool ok = true;
+    switch (type) {
+        case DataType::INTEGER:
+            if (auto value = parse_number<int>(initializer)) data_integer = *value;
+            else ok = false;
+            break;
+        case DataType::FLOAT:
+            if (auto value = parse_number<double>(initializer)) data_float = *value;
+            else ok = false;
+            break;
+        case DataType::TEXT:
+            data_text = std::move(initializer);
+            break;
+        case DataType::BIGINT:
+            if (auto value = parse_number<int64_t>(initializer)) data_bigint = *value;
+            else ok = false;
+            break;
+        case DataType::DECIMAL:
+            if (auto value = parse_decimal(initializer)) std::tie(data_bigint, data_scale) = *value;
+            else ok = false;
+            break;
+    }
+    if (!ok) {
         throw std::runtime_error("Failed to convert '" + initializer +
                                "' to type " + std::to_string(static_cast<int>(type)));
     }
 }
 
+CellData CellData::as(DataType target, DecimalSpec spec) const {
+    if (type == target && target != DataType::DECIMAL) return *this;
+    auto fail = [&](std::string column) -> CellData {
+        throw std::runtime_error("Cannot store " + std::string(*this) + " in a " + column + " column");
+    };
+    switch (target) {
+        case DataType::FLOAT: return CellData(double(*this));
+        case DataType::TEXT: return CellData(std::string(*this));
+        case DataType::INTEGER:
+        case DataType::BIGINT: {
+            int128 value;
+            if (exact()) {
+                if (unscaled() % POW10[scale()] != 0) return fail("whole number");
+                value = unscaled() / POW10[scale()];
+            } else if (type == DataType::FLOAT) {
+                if (!(std::fabs(data_float) < 9.2e18) || data_float != std::trunc(data_float)) return fail("whole number");
+                value = static_cast<int64_t>(data_float);
+            } else {
+                return CellData(target, data_text);
+            }
+            if (target == DataType::INTEGER) {
+                if (value > INT32_MAX || value < INT32_MIN) return fail("INTEGER");
+                return CellData(static_cast<int>(value));
+            }
+            return bigint(static_cast<int64_t>(value));
+        }
+        case DataType::DECIMAL: {
+            int128 value;
+            if (exact()) {
+                value = rescale(unscaled(), scale(), spec.scale);
+            } else if (type == DataType::FLOAT) {
+                double scaled = data_float * static_cast<double>(POW10[spec.scale]);
+                if (!(scaled > -9.2e18 && scaled < 9.2e18)) return fail("DECIMAL");
+                value = std::llround(scaled);
+            } else {
+                return CellData(DataType::DECIMAL, data_text).as(DataType::DECIMAL, spec);
+            }
+            if (value >= POW10[spec.precision] || value <= -POW10[spec.precision]) {
+                return fail("DECIMAL(" + std::to_string(spec.precision) + "," + std::to_string(spec.scale) + ")");
+            }
+            return decimal(static_cast<int64_t>(value), spec.scale);
+        }
+    }
+    return *this;
+}
+
 CellData::operator std::string() const {
    std::ostringstream os;
    os.precision(2);
@@ -42,6 +193,15 @@ CellData::operator std::string() const {
        case DataType::INTEGER: return std::to_string(data_integer);
        case DataType::FLOAT: os << data_float; return os.str();
        case DataType::TEXT: return data_text;
+       case DataType::BIGINT: return std::to_string(data_bigint);
+       case DataType::DECIMAL: {
+           // digits of |value|, padded so there is at least one before the point
+           uint64_t magnitude = data_bigint < 0 ? 0 - uint64_t(data_bigint) : uint64_t(data_bigint);
+           std::string digits = std::to_string(magnitude);
+           if (digits.size() <= size_t(data_scale)) digits.insert(0, data_scale + 1 - digits.size(), '0');
+           if (data_scale > 0) digits.insert(digits.size() - data_scale, 1, '.');
+           return data_bigint < 0 ? "-" + digits : digits;
+       }
    }
    return "";
 }
@@ -51,13 +211,31 @@ CellData::operator int() const {
         case DataType::INTEGER:
             return data_integer;
         case DataType::FLOAT:
+            if (!(data_float > INT32_MIN - 1.0 && data_float < INT32_MAX + 1.0)) break;
             return static_cast<int>(data_float);
         case DataType::TEXT:
-            try {
-                return std::stoi(data_text);
-            } catch (const std::exception& e) {
-                throw std::runtime_error("Cannot convert text '" + data_text + "' to integer");
-            }
+            if (auto value = parse_number<int>(data_text)) return *value;
+            if (auto value = parse_number<double>(data_text)) return int(CellData(*value));
+            throw std::runtime_error("Cannot convert text '" + data_text + "' to integer");
+        case DataType::BIGINT:
+        case DataType::DECIMAL: {
+            int64_t value = int64_t(*this);
+            if (value < INT32_MIN || value > INT32_MAX) break;
+            return static_cast<int>(value);
+        }
+    }
+    throw std::runtime_error("Value " + std::string(*this) + " is out of INTEGER range");
+}
+
+CellData::operator int64_t() const {
+    switch (type) {
+        case DataType::INTEGER: return data_integer;
+        case DataType::BIGINT: return data_bigint;
+        case DataType::DECIMAL: return data_bigint / POW10[data_scale];
+        case DataType::FLOAT: return static_cast<int64_t>(data_float);
+        case DataType::TEXT:
+            if (auto value = parse_number<int64_t>(data_text)) return *value;
+            return static_cast<int64_t>(double(*this));
     }
     throw std::runtime_error("Unknown data type");
 }
@@ -69,44 +247,138 @@ CellData::operator double() const {
         case DataType::FLOAT:
             return data_float;
         case DataType::TEXT:
-            try {
-                return std::stod(data_text);
-            } catch (const std::exception& e) {
-                throw std::runtime_error("Cannot convert text '" + data_text + "' to float");
-            }
+            if (auto value = parse_number<double>(data_text)) return *value;
+            throw std::runtime_error("Cannot convert text '" + data_text + "' to float");
+        case DataType::BIGINT:
+            return static_cast<double>(data_bigint);
+        case DataType::DECIMAL:
+            return static_cast<double>(data_bigint) / static_cast<double>(POW10[data_scale]);
     }
     throw std::runtime_error("Unknown data type");
 }
 
+std::partial_ordering CellData::operator<=>(const CellData& other) const {
+    if (type == DataType::TEXT || other.type == DataType::TEXT) {
+        return std::string(*this) <=> std::string(other);
+    }
+    if (type == DataType::INTEGER && other.type == DataType::INTEGER) {
+        return data_integer <=> other.data_integer;
+    }
+    if (exact() && other.exact()) {
+        int common = std::max(scale(), other.scale());
+        return rescale(unscaled(), scale(), common) <=> rescale(other.unscaled(), other.scale(), common);
+    }
+    return double(*this) <=> double(other);
+}
+
 bool CellData::truthy() const {
     switch (type) {
         case DataType::INTEGER: return data_integer != 0;
         case DataType::FLOAT: return data_float != 0.0;
         case DataType::TEXT: return !data_text.empty();
+        case DataType::BIGINT:
+        case DataType::DECIMAL: return data_bigint != 0;
     }
     return false;
 }
 
+// Numbers hash through their double value so that keys which compare equal
+// across numeric types (5, 5.00 and 5.0) land in the same bucket.
+size_t CellData::hash() const {
+    switch (type) {
+        case DataType::INTEGER: return std::hash<double>()(static_cast<double>(data_integer));
+        case DataType::FLOAT: return std::hash<double>()(data_float);
+        case DataType::TEXT: return std::hash<std::string>()(data_text);
+        case DataType::BIGINT:
+        case DataType::DECIMAL: return std::hash<double>()(double(*this));
+    }
+    return 0;
+}
+
+uint64_t mixed_hash(const CellData& cell) {
+    uint64_t h = cell.hash();
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 33);
+}
+
 std::ostream& operator<<(std::ostream& os, const CellData& cell) {
     return os << static_cast<std::string>(cell);
 }
 
+CellData arithmetic(ArithmeticOp op, const CellData& l, const CellData& r) {
+    if (!l.exact() || !r.exact()) {
+        double a = double(l), b = double(r);
+        switch (op) {
+            case ArithmeticOp::Add: return CellData(a + b);
+            case ArithmeticOp::Subtract: return CellData(a - b);
+            case ArithmeticOp::Multiply: return CellData(a * b);
+            case ArithmeticOp::Divide:
+                if (b == 0.0) throw std::runtime_error("Division by zero");
+                return CellData(a / b);
+        }
+    }
 
-DataType infer_datatype(const std::string& literal) {
-    try {
-        size_t pos;
-        std::stod(literal, &pos);
-        if (pos == literal.length()) {
-            return literal.find('.') == std::string::npos ? DataType::INTEGER : DataType::FLOAT;
+    bool is_decimal = l.type == DataType::DECIMAL || r.type == DataType::DECIMAL;
+    int scale = std::max(l.scale(), r.scale());
+    int128 a = l.unscaled(), b = r.unscaled();
+    int128 result = 0;
+    switch (op) {
+        case ArithmeticOp::Add:
+            result = rescale(a, l.scale(), scale) + rescale(b, r.scale(), scale);
+            break;
+        case ArithmeticOp::Subtract:
+            result = rescale(a, l.scale(), scale) - rescale(b, r.scale(), scale);
+            break;
+        case ArithmeticOp::Multiply:
+            // scales add up; keep as many fraction digits as the operands had between them
+            scale = std::min(l.scale() + r.scale(), CellData::MAX_DECIMAL_DIGITS);
+            result = rescale(a * b, l.scale() + r.scale(), scale);
+            break;
+        case ArithmeticOp::Divide: {
+            if (b == 0) throw std::runtime_error("Division by zero");
+            if (!is_decimal) {
+                // whole numbers: exact quotients stay whole, others become FLOAT as before
+                if (a % b != 0) return CellData(static_cast<double>(a) / static_cast<double>(b));
+                result = a / b;
+                break;
+            }
+            // (a / 10^sa) / (b / 10^sb) in 10^-scale units
+            int128 dividend;
+            if (__builtin_mul_overflow(a, pow10_wide(scale - l.scale() + r.scale()), &dividend)) {
+                throw std::runtime_error("Numeric overflow");
+            }
+            result = divide_rounded(dividend, b);
+            break;
         }
-    } catch (...) {}
-    return DataType::TEXT;
+    }
+    if (is_decimal) return CellData::decimal(narrow(result), scale);
+    if (l.type == DataType::INTEGER && r.type == DataType::INTEGER && result >= INT32_MIN && result <= INT32_MAX) {
+        return CellData(static_cast<int>(result));
+    }
+    return CellData::bigint(narrow(result));
 }
 
+DataType infer_datatype(const std::string& literal) {
+    return inferred_cell(literal).type;
+}
+
+// Whole numbers too big for an int become BIGINT; beyond that, and for
+// exponent forms like 1e5, FLOAT.
 CellData inferred_cell(const std::string& literal){
-    switch(infer_datatype(literal)) {
-        case DataType::INTEGER: return CellData(std::stoi(literal));
-        case DataType::FLOAT: return CellData(std::stod(literal));
-        default: return CellData(literal);
-    }
+    if (auto value = parse_number<int>(literal)) return CellData(*value);
+    if (auto value = parse_number<int64_t>(literal)) return CellData::bigint(*value);
+    if (auto value = parse_number<double>(literal)) return CellData(*value);
+    return CellData(literal);
+}
+
+// Numbers written with a point are FLOAT, but stand for this exact value next to a
+// DECIMAL, so that `amount = 0.10` compares and stores 0.10 itself.
+std::optional<CellData> exact_literal(const std::string& literal) {
+    if (literal.find('.') == std::string::npos) return std::nullopt;
+    auto value = parse_decimal(literal);
+    if (!value) return std::nullopt;
+    return CellData::decimal(value->first, value->second);
 }
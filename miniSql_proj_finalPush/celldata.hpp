@@ -3,55 +3,92 @@
 
 #include <string>
 #include <ostream>
+#include <cstdint>
+#include <optional>
 
 enum class DataType {
     INTEGER,
     FLOAT,
-    TEXT
+    TEXT,
+    BIGINT,   // 64-bit integer
+    DECIMAL   // fixed point: a 64-bit integer scaled by 10^scale
+};
+
+// Total digits and digits after the point of a DECIMAL column.
+struct DecimalSpec {
+    int precision = 18;
+    int scale = 0;
 };
 
 class CellData {
 public:
-    DataType type;
-    CellData() = default;
+    static constexpr int MAX_DECIMAL_DIGITS = 18;
+
+    DataType type = DataType::INTEGER;
+    CellData() = default;  // INTEGER 0
     CellData(DataType type);
     CellData(DataType type, std::string initializer);
-    
+
     CellData(int value) : type(DataType::INTEGER), data_integer(value) {}
     CellData(double value) : type(DataType::FLOAT), data_float(value) {}
     CellData(const char* value) : type(DataType::TEXT), data_text(value) {}
     CellData(std::string value) : type(DataType::TEXT), data_text(std::move(value)) {}
+    static CellData bigint(int64_t value);
+    static CellData decimal(int64_t unscaled, int scale);
 
     void read(std::string initializer);
-    
+    CellData as(DataType target, DecimalSpec spec = {}) const;  // the value as a column of `target` stores it
+
     operator std::string() const;
     operator int() const;
     operator double() const;
-    
+    explicit operator int64_t() const;
+
+    // INTEGER, BIGINT and DECIMAL values as an integer count of 10^-scale() units
+    int64_t unscaled() const { return type == DataType::INTEGER ? data_integer : data_bigint; }
+    int scale() const { return type == DataType::DECIMAL ? data_scale : 0; }
+    bool exact() const { return type == DataType::INTEGER || type == DataType::BIGINT || type == DataType::DECIMAL; }
+
     friend std::ostream& operator<<(std::ostream& os, const CellData& cell);
     bool truthy() const;
-    
-    
-    std::partial_ordering operator<=>(const CellData& other) const {
-            if (type == DataType::TEXT || other.type == DataType::TEXT) {
-                return std::string(*this) <=> std::string(other);
-            }
-            if (type == DataType::INTEGER && other.type == DataType::INTEGER) {
-                return int(*this) <=> int(other);
-            }
-            return double(*this) <=> double(other);
-        }
-        
-        bool operator==(const CellData& other) const = default;
+    size_t hash() const;
+
+    // Text against anything compares as strings, FLOAT against numbers as doubles,
+    // and INTEGER/BIGINT/DECIMAL against each other exactly.
+    std::partial_ordering operator<=>(const CellData& other) const;
+    bool operator==(const CellData& other) const { return (*this <=> other) == 0; }
 
 private:
-    int data_integer;
-    double data_float;
+    int data_integer = 0;
+    double data_float = 0.0;
     std::string data_text;
+    int64_t data_bigint = 0;
+    int data_scale = 0;
+};
+
+// Hash/equality for using cells as keys of unordered containers; equality follows
+// the comparison operators, so 5 and 5.0 are the same key.
+struct CellDataHash {
+    size_t operator()(const CellData& cell) const { return cell.hash(); }
 };
 
+struct CellDataEqual {
+    bool operator()(const CellData& a, const CellData& b) const { return (a <=> b) == 0; }
+};
+
+// hash() with every bit mixed, for sketches and filters that slice it into parts
+// (hashes of small integers are far from uniform on their own)
+uint64_t mixed_hash(const CellData& cell);
+
+// Arithmetic used by the expression operators. INTEGER, BIGINT and DECIMAL
+// operands are computed exactly in 64 bits (overflow throws); anything involving
+// FLOAT or TEXT goes through double.
+enum class ArithmeticOp { Add, Subtract, Multiply, Divide };
+CellData arithmetic(ArithmeticOp op, const CellData& l, const CellData& r);
+
 DataType infer_datatype(const std::string& literal);
 
 CellData inferred_cell(const std::string& literal) ;
+std::optional<CellData> exact_literal(const std::string& literal);  // the DECIMAL a number with a point spells
 
 #endif
@@ -0,0 +1,35 @@
+#ifndef COPY_ON_WRITE_H
+#define COPY_ON_WRITE_H
+
+#include <memory>
+
+// A reference-counted value that copies share until one of them is changed.
+// Reads go through * and ->, which never copy; edit() first gives this holder a
+// private copy if anyone else still refers to the same value.
+template <typename T>
+class CopyOnWrite {
+public:
+    CopyOnWrite() = default;
+    CopyOnWrite(T value) : data(std::make_shared<T>(std::move(value))) {}
+
+    const T& operator*() const { return data ? *data : empty(); }
+    const T* operator->() const { return &**this; }
+
+    T& edit() {
+        if (!data) data = std::make_shared<T>();
+        else if (data.use_count() > 1) data = std::make_shared<T>(*data);
+        return *data;
+    }
+
+    bool shares_with(const CopyOnWrite& other) const { return data && data == other.data; }
+
+private:
+    std::shared_ptr<T> data;  // null until first edited, and after being moved from
+
+    static const T& empty() {
+        static const T value{};
+        return value;
+    }
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "csv_manip.hpp"
+#include <charconv>
 
 std::vector<std::string> split_csv(std::string line) {
     std::vector<std::string> fields;
@@ -14,16 +15,100 @@ std::string datatype_to_string(DataType type) {
     switch(type) {
         case DataType::INTEGER: return "INTEGER";
         case DataType::FLOAT: return "FLOAT";
+        case DataType::BIGINT: return "BIGINT";
+        case DataType::DECIMAL: return "DECIMAL";
         default: return "TEXT";
     }
 }
 
+// The type as CREATE TABLE declares it, with a DECIMAL's precision and scale.
+static std::string column_type(Table& table, size_t column) {
+    std::string type = datatype_to_string(table.schema[column]);
+    if (table.schema[column] == DataType::DECIMAL) {
+        auto spec = table.decimal_spec(column);
+        type += "(" + std::to_string(spec.precision) + "," + std::to_string(spec.scale) + ")";
+    }
+    return type;
+}
+
 DataType string_to_datatype(std::string type) {
     if(type == "INTEGER") return DataType::INTEGER;
     if(type == "FLOAT") return DataType::FLOAT;
+    if(type == "BIGINT") return DataType::BIGINT;
+    if(type == "DECIMAL") return DataType::DECIMAL;
     return DataType::TEXT;
 }
 
+// "DECIMAL(10,2)" -> "DECIMAL" with the spec filled in
+static std::string strip_decimal_spec(std::string type, DecimalSpec& spec) {
+    if(!type.starts_with("DECIMAL(") || !type.ends_with(")")) return type;
+    std::string args = type.substr(8, type.size() - 9);
+    size_t comma = args.find(',');
+    spec.precision = int(CellData(DataType::INTEGER, args.substr(0, comma)));
+    spec.scale = comma == std::string::npos ? 0 : int(CellData(DataType::INTEGER, args.substr(comma + 1)));
+    return "DECIMAL";
+}
+
+static bool strip_attribute(std::string& type, std::string attribute) {
+    if(!type.ends_with(attribute)) return false;
+    type.erase(type.size() - attribute.size());
+    return true;
+}
+
+// Reads one record into `fields`; a quoted field may run over several lines.
+// Only a quote at the start of a field opens quoting, so older files with bare
+// quotes inside text still read back as written. Adds the physical lines consumed
+// to `lines_read` when given.
+static bool read_csv_record(std::istream& in, std::string& line, std::vector<std::string>& fields,
+                            size_t* lines_read = nullptr) {
+    fields.clear();
+    if(!std::getline(in, line)) return false;
+    if(lines_read) ++*lines_read;
+    std::string field;
+    bool quoted = false;
+    size_t field_start = 0;
+    for(size_t i = 0; ; i++) {
+        if(i == line.size()) {
+            if(!quoted) break;
+            // newline inside a quoted field
+            if(!std::getline(in, line)) throw std::runtime_error("Unterminated quoted CSV field");
+            if(lines_read) ++*lines_read;
+            field += '\n';
+            i = size_t(-1);
+            continue;
+        }
+        char c = line[i];
+        if(quoted) {
+            if(c != '"') field += c;
+            else if(i + 1 < line.size() && line[i + 1] == '"') field += line[++i];
+            else quoted = false;
+        } else if(c == '"' && i == field_start && field.empty()) {
+            quoted = true;
+        } else if(c == ',') {
+            fields.push_back(std::move(field));
+            field.clear();
+            field_start = i + 1;
+        } else if(c != '\r' || i + 1 != line.size()) {
+            field += c;
+        }
+    }
+    fields.push_back(std::move(field));
+    return true;
+}
+
+static void write_csv_field(std::ostream& out, std::string_view text) {
+    if(text.find_first_of(",\"\n\r") == std::string_view::npos) {
+        out << text;
+        return;
+    }
+    out << '"';
+    for(char c : text) {
+        if(c == '"') out << '"';
+        out << c;
+    }
+    out << '"';
+}
+
 // csv_manip.cpp
 std::string csv_dumps(Table table, bool with_type_info, bool quoted_strs) {
     std::ostringstream ss;
@@ -41,13 +126,16 @@ std::string csv_dumps(Table table, bool with_type_info, bool quoted_strs) {
     if (with_type_info) {
         for(size_t i = 0; i < table.schema.elements.size(); i++) {
             if(i > 0) ss << ',';
-            ss << datatype_to_string(table.schema[i]);
+            std::string type = column_type(table, i);
+            if (table.schema.elements[i].name == table.primary_key) type += " PRIMARY KEY";
+            if (table.has_bitmap_index(table.schema.elements[i].name)) type += " BITMAP";
+            write_csv_field(ss, type);
         }
         ss << '\n';
     }
     
     // Data
-    for(auto &row : table.rows) {
+    for(auto &row : *table.rows) {
         for(size_t i = 0; i < row.cells.elements.size(); i++) {
             if(i > 0) ss << ',';
             const auto& cell = row.cells[i];
@@ -55,6 +143,9 @@ std::string csv_dumps(Table table, bool with_type_info, bool quoted_strs) {
                 ss << "\'" << std::string(cell) << "\'";
             } else if (cell.type == DataType::FLOAT) {
                 ss << double(cell);
+            } else if (cell.type == DataType::TEXT) {
+                // table files: text with separators is quoted so it reads back intact
+                write_csv_field(ss, std::string(cell));
             } else {
                 ss << std::string(cell);
             }
@@ -64,19 +155,29 @@ std::string csv_dumps(Table table, bool with_type_info, bool quoted_strs) {
     return ss.str();
 }
 
-Table csv_loads(std::string csv_str, std::string table_name, bool with_type_info, bool quoted_strs) {
+Table csv_loads(std::string csv_str, std::string table_name, [[maybe_unused]] bool with_type_info, bool quoted_strs, bool build_indexes) {
     std::stringstream ss(csv_str);
     std::string line;
+    std::vector<std::string> fields;
     
-    std::getline(ss, line);
-    auto headers = split_csv(line);
+    read_csv_record(ss, line, fields);
+    auto headers = fields;
     
     // Try to read types if present
-    std::getline(ss, line);
-    auto types = split_csv(line);
+    read_csv_record(ss, line, fields);
+    auto types = fields;
     bool has_types = true;
-    for(auto type : types) {
-        if(type != "INTEGER" && type != "FLOAT" && type != "TEXT") {
+    std::string primary_key;
+    std::vector<std::string> bitmap_columns;
+    std::vector<DecimalSpec> decimals(headers.size());
+    for(size_t i = 0; i < types.size() && i < headers.size(); i++) {
+        // column attributes follow the type: "DECIMAL(10,2) PRIMARY KEY BITMAP"
+        std::string type = types[i];
+        if(strip_attribute(type, " BITMAP")) bitmap_columns.push_back(headers[i]);
+        if(strip_attribute(type, " PRIMARY KEY")) primary_key = headers[i];
+        type = strip_decimal_spec(type, decimals[i]);
+        types[i] = type;
+        if(type != "INTEGER" && type != "FLOAT" && type != "TEXT" && type != "BIGINT" && type != "DECIMAL") {
             has_types = false;
             break;
         }
@@ -88,6 +189,9 @@ Table csv_loads(std::string csv_str, std::string table_name, bool with_type_info
             schema[headers[i]] = string_to_datatype(types[i]);
         }
     } else {
+        primary_key = "";
+        bitmap_columns.clear();
+        decimals.assign(headers.size(), DecimalSpec());
         // If no type info, default to TEXT
         for(auto header : headers) {
             schema[header] = DataType::TEXT;
@@ -95,14 +199,14 @@ Table csv_loads(std::string csv_str, std::string table_name, bool with_type_info
         // Reset stream position to process the line as data
         ss.clear();
         ss.seekg(0);
-        std::getline(ss, line); // Skip header
+        read_csv_record(ss, line, fields); // Skip header
     }
     
     Table table(table_name, schema);
+    table.decimals = decimals;
     
-    while(std::getline(ss, line)) {
-        if(line.empty()) continue;
-        auto fields = split_csv(line);
+    while(read_csv_record(ss, line, fields)) {
+        if(fields.size() == 1 && fields[0].empty()) continue;
         Row row(schema);
         for(size_t i = 0; i < fields.size(); i++) {
             std::string field = fields[i];
@@ -116,6 +220,12 @@ Table csv_loads(std::string csv_str, std::string table_name, bool with_type_info
         }
         table.append_row(row);
     }
+
+    // indexes are declared after the rows are in and built in one pass, or left
+    // for the caller to restore from an index file
+    table.primary_key = primary_key;
+    for(auto col : bitmap_columns) table.bitmap_indexes.edit().push_back(BitmapIndex(table.column_index(col)));
+    if(build_indexes) table.rebuild_indexes();
     return table;
 }
 
@@ -123,9 +233,84 @@ void csv_dump(Table table, std::string filepath, bool with_type_info, bool quote
     std::ofstream(filepath) << csv_dumps(table, with_type_info, quoted_strs);
 }
 
-Table csv_load(std::string filepath, std::string table_name, bool with_type_info, bool quoted_strs) {
+Table csv_load(std::string filepath, std::string table_name, bool with_type_info, bool quoted_strs, bool build_indexes) {
     std::ifstream file(filepath);
     std::stringstream buffer;
     buffer << file.rdbuf();
-    return csv_loads(buffer.str(), table_name, with_type_info, quoted_strs);
+    return csv_loads(buffer.str(), table_name, with_type_info, quoted_strs, build_indexes);
+}
+
+size_t csv_copy_from(Table& table, std::string filepath) {
+    std::ifstream file(filepath, std::ios::binary);
+    if(!file) throw std::runtime_error("Could not open " + filepath);
+
+    std::string line;
+    std::vector<std::string> fields;
+    size_t lines_read = 0;
+    if(!read_csv_record(file, line, fields, &lines_read)) throw std::runtime_error("Missing header in " + filepath);
+    // header order may differ from the table's
+    size_t width = table.schema.size();
+    if(fields.size() != width) throw std::runtime_error("Column count mismatch in " + filepath);
+    std::vector<size_t> target(width);
+    for(size_t i = 0; i < width; i++) target[i] = table.column_index(fields[i]);
+
+    // the rows go in as one batch, so a bad record leaves the table untouched
+    std::vector<Row> batch;
+    Row blank(table.schema);
+    while(true) {
+        size_t line_no = lines_read + 1;  // where the record starts; quoted fields may span lines
+        if(!read_csv_record(file, line, fields, &lines_read)) break;
+        if(fields.size() == 1 && fields[0].empty()) continue;
+        if(fields.size() != width) {
+            throw std::runtime_error("Expected " + std::to_string(width) + " fields on line " +
+                                     std::to_string(line_no) + " of " + filepath);
+        }
+        batch.push_back(blank);
+        auto& cells = batch.back().cells.elements;
+        for(size_t i = 0; i < width; i++) {
+            size_t c = target[i];
+            if(table.schema[c] == DataType::TEXT) {
+                cells[c].value = CellData(DataType::TEXT, std::move(fields[i]));
+                continue;
+            }
+            try {
+                cells[c].value = table.coerce(c, CellData(table.schema[c], fields[i]));
+            } catch(const std::runtime_error&) {
+                throw std::runtime_error(filepath + ":" + std::to_string(line_no) + ": cannot convert '" +
+                                         fields[i] + "' to " + column_type(table, c));
+            }
+        }
+    }
+    size_t count = batch.size();
+    table.append_rows(std::move(batch));
+    return count;
+}
+
+size_t csv_copy_to(Table& table, std::string filepath) {
+    std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+    if(!file) throw std::runtime_error("Could not open " + filepath);
+
+    for(size_t i = 0; i < table.schema.size(); i++) {
+        if(i > 0) file << ',';
+        write_csv_field(file, table.schema.elements[i].name);
+    }
+    file << '\n';
+
+    char number[32];
+    for(auto& row : *table.rows) {
+        for(size_t i = 0; i < row.cells.elements.size(); i++) {
+            if(i > 0) file << ',';
+            auto& cell = row.cells.elements[i].value;
+            if(cell.type == DataType::FLOAT) {
+                // shortest text that reads back as the same double, unlike the 2-decimal display form
+                auto end = std::to_chars(number, number + sizeof(number), double(cell)).ptr;
+                file.write(number, end - number);
+            } else {
+                write_csv_field(file, std::string(cell));
+            }
+        }
+        file << '\n';
+    }
+    if(!file) throw std::runtime_error("Failed writing " + filepath);
+    return table.rows->size();
 }
@@ -9,8 +9,12 @@ std::vector<std::string> split_csv(std::string line);
 std::string datatype_to_string(DataType type);
 DataType string_to_datatype(std::string type);
 std::string csv_dumps(Table table, bool with_type_info = false, bool quoted_strs = false);
-Table csv_loads(std::string csv_str, std::string table_name, bool with_type_info = true, bool quoted_strs = false);
+Table csv_loads(std::string csv_str, std::string table_name, bool with_type_info = true, bool quoted_strs = false, bool build_indexes = true);
 void csv_dump(Table table, std::string filepath, bool with_type_info = false, bool quoted_strs = false);
-Table csv_load(std::string filepath, std::string table_name, bool with_type_info = true, bool quoted_strs = false);
+// Bulk import/export for COPY: a header line naming the columns, then one record
+// per row. Fields containing , " or a newline are quoted with "" as the escape.
+size_t csv_copy_from(Table& table, std::string filepath);
+size_t csv_copy_to(Table& table, std::string filepath);
+Table csv_load(std::string filepath, std::string table_name, bool with_type_info = true, bool quoted_strs = false, bool build_indexes = true);
 
 #endif
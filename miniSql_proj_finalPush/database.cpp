@@ -1,10 +1,16 @@
 #include "database.hpp"
 
-Table& Database::create_table(std::string name, Schema schema) {
+Table& Database::create_table(std::string name, Schema schema, std::string primary_key,
+                              std::vector<DecimalSpec> decimals) {
     if (has_table(name)) {
         throw std::runtime_error("Table \"" + name + "\" already exists");
     }
-    auto [it, success] = tables.emplace(name, Table(name, schema));
+    Table table(name, schema);
+    table.primary_key = primary_key;
+    table.decimals = decimals;
+    table.rebuild_indexes();
+    auto [it, success] = tables.emplace(name, std::move(table));
+    schema_version++;
     return it->second;
 }
 
@@ -25,4 +31,5 @@ void Database::drop_table(std::string name) {
         throw std::runtime_error("Table not found: " + name);
     }
     tables.erase(name);
+    schema_version++;
 }
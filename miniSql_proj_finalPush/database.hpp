@@ -2,13 +2,18 @@
 #define DATABASE_H
 
 #include "table.hpp"
+#include <cstdint>
 #include <unordered_map>
 
 class Database {
 public:
     std::unordered_map<std::string, Table> tables;
+    // Bumped whenever tables come or go or their indexes or statistics change;
+    // prepared statements only reuse their plans while it stays the same.
+    uint64_t schema_version = 0;
     
-    Table &create_table(std::string name, Schema schema);
+    Table &create_table(std::string name, Schema schema, std::string primary_key = "",
+                        std::vector<DecimalSpec> decimals = {});
     Table &get_table(std::string name);
     bool has_table(std::string name);
     void drop_table(std::string name);
@@ -1,16 +1,42 @@
 #include "disk_storage.hpp"
 #include "csv_manip.hpp"
+#include "index_file.hpp"
+#include "stats.hpp"
 #include <filesystem>
 #include <iostream>
 namespace fs = std::filesystem;
 void DiskStorage::save_database(Database db, std::string name) {
+    auto start = StatsClock::now();
+    uint64_t written = 0;
     fs::path db_path = fs::path("./dbs") / name;
     fs::create_directories(db_path);
     
     for (auto& pair : db.tables) {
-        //std::cout << "Saving table " << pair.first << " with " << pair.second.rows.size() << " rows\n";
+        //std::cout << "Saving table " << pair.first << " with " << pair.second.rows->size() << " rows\n";
         std::string table_path = (db_path / (pair.first + ".csv")).string();
         csv_dump(pair.second, table_path, true);
+        written += file_bytes(table_path);
+
+        // indexes go next to the table, stamped with the file they describe
+        fs::path index_path = db_path / (pair.first + ".idx");
+        Table& table = pair.second;
+        if (table.primary_key.empty() && table.bitmap_indexes->empty()) {
+            fs::remove(index_path);
+        } else {
+            write_index_file(table, index_path.string(), stamp_table_file(table_path, table.rows->size()));
+            written += file_bytes(index_path.string());
+        }
+        fs::path stats_path = db_path / (pair.first + ".stats");
+        if (!table.stats->analyzed) {
+            fs::remove(stats_path);
+        } else {
+            write_stats_file(table, stats_path.string(), stamp_table_file(table_path, table.rows->size()));
+            written += file_bytes(stats_path.string());
+        }
+    }
+    if (current_stats) {
+        current_stats->persist_ms += elapsed_ms(start);
+        current_stats->disk_bytes_written += written;
     }
 }
 /*
@@ -39,13 +65,30 @@ std::shared_ptr<Database> DiskStorage::load_database(std::string name) {
         throw std::runtime_error("Database not found: " + name);
     }
     
+    auto start = StatsClock::now();
+    uint64_t read = 0;
     auto db = std::make_shared<Database>();
     for (auto entry : fs::directory_iterator(db_path)) {
         if (entry.path().extension() == ".csv") {
             std::string table_name = entry.path().stem().string();
-            db->tables[table_name] = csv_load(entry.path().string(), table_name);
+            read += file_bytes(entry.path().string());
+            Table table = csv_load(entry.path().string(), table_name, true, false, false);
+            fs::path index_path = db_path / (table_name + ".idx");
+            IndexStamp stamp = stamp_table_file(entry.path().string(), table.rows->size());
+            if (read_index_file(table, index_path.string(), stamp)) {
+                read += file_bytes(index_path.string());
+            } else {
+                table.rebuild_indexes();
+            }
+            fs::path stats_path = db_path / (table_name + ".stats");
+            if (read_stats_file(table, stats_path.string(), stamp)) read += file_bytes(stats_path.string());
+            db->tables[table_name] = std::move(table);
         }
     }
+    if (current_stats) {
+        current_stats->persist_ms += elapsed_ms(start);
+        current_stats->disk_bytes_read += read;
+    }
     return db;
 }
 
@@ -1,113 +1,154 @@
 // expr.cpp
 #include "expr.hpp"
 #include "row.hpp"
-bool Expr::truthy(Row row) { return eval(row).truthy(); }
-BinaryOp::BinaryOp(ExprPtr l, ExprPtr r) : left(l), right(r) {}
+#include "arena.hpp"
+#include <algorithm>
+bool Expr::truthy(const Row& row) { return eval(row).truthy(); }
+BinaryOp::BinaryOp(ExprPtr l, ExprPtr r) : left(l), right(r) {
+    auto exact = [](ExprPtr e) -> const Literal* {
+        auto lit = dynamic_cast<const Literal*>(e.get());
+        return lit && lit->exact ? lit : nullptr;
+    };
+    left_literal = exact(l);
+    right_literal = exact(r);
+}
+
+std::pair<CellData, CellData> BinaryOp::operands(const Row& row) {
+    CellData l = left->eval(row), r = right->eval(row);
+    if (right_literal) r = right_literal->against(l.type);
+    if (left_literal) l = left_literal->against(r.type);
+    return {std::move(l), std::move(r)};
+}
 UnaryOp::UnaryOp(ExprPtr op) : operand(op) {}
 
+static std::string operand_str(ExprPtr e) {
+    bool nested = dynamic_cast<BinaryOp*>(e.get()) || dynamic_cast<UnaryOp*>(e.get());
+    return nested ? "(" + e->str() + ")" : e->str();
+}
+
+std::string BinaryOp::str_with(std::string symbol) {
+    return operand_str(left) + " " + symbol + " " + operand_str(right);
+}
+
+// Numeric work lives in CellData: `arithmetic` for + - * / and operator<=> for
+// comparisons, so every operator promotes INTEGER/BIGINT/DECIMAL/FLOAT the same way.
+
 class Op_Add : public BinaryOp {
 public:
     using BinaryOp::BinaryOp;
-    CellData eval(Row row) override {
-        CellData l = left->eval(row);
-        CellData r = right->eval(row);
-        return l.type == DataType::INTEGER && r.type == DataType::INTEGER ?
-            CellData(int(l) + int(r)) : CellData(double(l) + double(r));
+    std::string str() override { return str_with("+"); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_Add>(l, r); }
+    CellData eval(const Row& row) override {
+        auto [l, r] = operands(row);
+        return arithmetic(ArithmeticOp::Add, l, r);
     }
 };
 
 class Op_Subtract : public BinaryOp {
 public:
     using BinaryOp::BinaryOp;
-    CellData eval(Row row) override {
-        CellData l = left->eval(row);
-        CellData r = right->eval(row);
-        return l.type == DataType::INTEGER && r.type == DataType::INTEGER ?
-            CellData(int(l) - int(r)) : CellData(double(l) - double(r));
+    std::string str() override { return str_with("-"); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_Subtract>(l, r); }
+    CellData eval(const Row& row) override {
+        auto [l, r] = operands(row);
+        return arithmetic(ArithmeticOp::Subtract, l, r);
     }
 };
 
 class Op_Multiply : public BinaryOp {
 public:
     using BinaryOp::BinaryOp;
-    CellData eval(Row row) override {
-        CellData l = left->eval(row);
-        CellData r = right->eval(row);
-        return l.type == DataType::INTEGER && r.type == DataType::INTEGER ?
-            CellData(int(l) * int(r)) : CellData(double(l) * double(r));
+    std::string str() override { return str_with("*"); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_Multiply>(l, r); }
+    CellData eval(const Row& row) override {
+        auto [l, r] = operands(row);
+        return arithmetic(ArithmeticOp::Multiply, l, r);
     }
 };
 
 class Op_Divide : public BinaryOp {
 public:
     using BinaryOp::BinaryOp;
-    CellData eval(Row row) override {
-        CellData l = left->eval(row);
-        CellData r = right->eval(row);
-        double divisor = double(r);
-        if(divisor == 0.0) throw std::runtime_error("Division by zero");
-        if(l.type == DataType::INTEGER && r.type == DataType::INTEGER) {
-            int i_divisor = int(r);
-            if(i_divisor != 0 && int(l) % i_divisor == 0) {
-                return CellData(int(l) / i_divisor);
-            }
-        }
-        return CellData(double(l) / divisor);
+    std::string str() override { return str_with("/"); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_Divide>(l, r); }
+    CellData eval(const Row& row) override {
+        auto [l, r] = operands(row);
+        return arithmetic(ArithmeticOp::Divide, l, r);
     }
 };
 
 class Op_Less : public BinaryOp {
 public:
     using BinaryOp::BinaryOp;
-    CellData eval(Row row) override {
-        CellData l = left->eval(row);
-        CellData r = right->eval(row);
-        if(l.type == DataType::TEXT || r.type == DataType::TEXT) {
-            return CellData(std::string(l) < std::string(r));
-        }
-        if(l.type == DataType::INTEGER && r.type == DataType::INTEGER) {
-            return CellData(int(l) < int(r));
-        }
-        return CellData(double(l) < double(r));
+    std::string str() override { return str_with("<"); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_Less>(l, r); }
+    CellData eval(const Row& row) override {
+        auto [l, r] = operands(row);
+        return CellData(l < r);
     }
 };
 
 class Op_Equal : public BinaryOp {
 public:
     using BinaryOp::BinaryOp;
-    CellData eval(Row row) override {
-        CellData l = left->eval(row);
-        CellData r = right->eval(row);
-        if(l.type == DataType::TEXT || r.type == DataType::TEXT) {
-            return CellData(std::string(l) == std::string(r));
-        }
-        if(l.type == DataType::INTEGER && r.type == DataType::INTEGER) {
-            return CellData(int(l) == int(r));
-        }
-        return CellData(double(l) == double(r));
+    std::string str() override { return str_with("="); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_Equal>(l, r); }
+    CellData eval(const Row& row) override {
+        auto [l, r] = operands(row);
+        return CellData(l == r);
     }
 };
 
 class Op_Greater : public BinaryOp {
 public:
     using BinaryOp::BinaryOp;
-    CellData eval(Row row) override {
-        CellData l = left->eval(row);
-        CellData r = right->eval(row);
-        if(l.type == DataType::TEXT || r.type == DataType::TEXT) {
-            return CellData(std::string(l) > std::string(r));
-        }
-        if(l.type == DataType::INTEGER && r.type == DataType::INTEGER) {
-            return CellData(int(l) > int(r));
-        }
-        return CellData(double(l) > double(r));
+    std::string str() override { return str_with(">"); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_Greater>(l, r); }
+    CellData eval(const Row& row) override {
+        auto [l, r] = operands(row);
+        return CellData(l > r);
+    }
+};
+
+class Op_LessEqual : public BinaryOp {
+public:
+    using BinaryOp::BinaryOp;
+    std::string str() override { return str_with("<="); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_LessEqual>(l, r); }
+    CellData eval(const Row& row) override {
+        auto [l, r] = operands(row);
+        return CellData(l <= r);
+    }
+};
+
+class Op_GreaterEqual : public BinaryOp {
+public:
+    using BinaryOp::BinaryOp;
+    std::string str() override { return str_with(">="); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_GreaterEqual>(l, r); }
+    CellData eval(const Row& row) override {
+        auto [l, r] = operands(row);
+        return CellData(l >= r);
+    }
+};
+
+class Op_NotEqual : public BinaryOp {
+public:
+    using BinaryOp::BinaryOp;
+    std::string str() override { return str_with("<>"); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_NotEqual>(l, r); }
+    CellData eval(const Row& row) override {
+        auto [l, r] = operands(row);
+        return CellData(l != r);
     }
 };
 
 class Op_And : public BinaryOp {
 public:
     using BinaryOp::BinaryOp;
-    CellData eval(Row row) override {
+    std::string str() override { return str_with("AND"); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_And>(l, r); }
+    CellData eval(const Row& row) override {
         return CellData(left->truthy(row) && right->truthy(row));
     }
 };
@@ -115,7 +156,9 @@ public:
 class Op_Or : public BinaryOp {
 public:
     using BinaryOp::BinaryOp;
-    CellData eval(Row row) override {
+    std::string str() override { return str_with("OR"); }
+    ExprPtr with_operands(ExprPtr l, ExprPtr r) override { return make_temp<Op_Or>(l, r); }
+    CellData eval(const Row& row) override {
         return CellData(left->truthy(row) || right->truthy(row));
     }
 };
@@ -123,22 +166,70 @@ public:
 class Op_Not : public UnaryOp {
 public:
     using UnaryOp::UnaryOp;
-    CellData eval(Row row) override {
+    std::string str() override { return "NOT " + operand_str(operand); }
+    ExprPtr with_operand(ExprPtr op) override { return make_temp<Op_Not>(op); }
+    CellData eval(const Row& row) override {
         return CellData(!operand->truthy(row));
     }
 };
 
-CellData ColRef::eval(Row row) {
+class Op_Negate : public UnaryOp {
+public:
+    using UnaryOp::UnaryOp;
+    std::string str() override { return "-" + operand_str(operand); }
+    ExprPtr with_operand(ExprPtr op) override { return make_temp<Op_Negate>(op); }
+    CellData eval(const Row& row) override {
+        return arithmetic(ArithmeticOp::Subtract, CellData(0), operand->eval(row));
+    }
+};
+
+CellData ColRef::eval(const Row& row) {
+    // rows of one table share a layout, so the position found for the first row
+    // usually holds for the rest
+    auto& cells = row.cells.elements;
+    if (position < cells.size() && cells[position].name == name) return cells[position].value;
+    for (size_t i = 0; i < cells.size(); i++) {
+        if (cells[i].name == name) {
+            position = i;
+            return cells[i].value;
+        }
+    }
     return row[name];
 }
 
-ExprPtr operator+(ExprPtr l, ExprPtr r) { return std::make_shared<Op_Add>(l, r); }
-ExprPtr operator-(ExprPtr l, ExprPtr r) { return std::make_shared<Op_Subtract>(l, r); }
-ExprPtr operator*(ExprPtr l, ExprPtr r) { return std::make_shared<Op_Multiply>(l, r); }
-ExprPtr operator/(ExprPtr l, ExprPtr r) { return std::make_shared<Op_Divide>(l, r); }
-ExprPtr operator<(ExprPtr l, ExprPtr r) { return std::make_shared<Op_Less>(l, r); }
-ExprPtr operator==(ExprPtr l, ExprPtr r) { return std::make_shared<Op_Equal>(l, r); }
-ExprPtr operator>(ExprPtr l, ExprPtr r) { return std::make_shared<Op_Greater>(l, r);}
+Param::Param(std::shared_ptr<ParamValues> values, size_t index) : values(values), index(index) {}
+
+CellData Param::value() {
+    auto& bound = (*values)[index];
+    if (!bound) throw std::runtime_error("Parameter " + std::to_string(index) + " is not bound");
+    return *bound;
+}
+
+CellData Param::eval(const Row&) {
+    return value();
+}
+
+Subquery::Subquery(ExprPtr operand, std::shared_ptr<SelectStatement> query) : operand(operand), query(query) {}
+
+CellData Subquery::eval(const Row&) {
+    throw std::runtime_error("Subqueries are only supported as AND-ed terms of WHERE");
+}
+
+std::string Subquery::str() {
+    if (operand.get() == nullptr) return std::string(negated ? "NOT " : "") + "EXISTS (SELECT ...)";
+    return operand_str(operand) + (negated ? " NOT IN" : " IN") + " (SELECT ...)";
+}
+
+ExprPtr operator+(ExprPtr l, ExprPtr r) { return make_temp<Op_Add>(l, r); }
+ExprPtr operator-(ExprPtr l, ExprPtr r) { return make_temp<Op_Subtract>(l, r); }
+ExprPtr operator*(ExprPtr l, ExprPtr r) { return make_temp<Op_Multiply>(l, r); }
+ExprPtr operator/(ExprPtr l, ExprPtr r) { return make_temp<Op_Divide>(l, r); }
+ExprPtr operator<(ExprPtr l, ExprPtr r) { return make_temp<Op_Less>(l, r); }
+ExprPtr operator==(ExprPtr l, ExprPtr r) { return make_temp<Op_Equal>(l, r); }
+ExprPtr operator>(ExprPtr l, ExprPtr r) { return make_temp<Op_Greater>(l, r);}
+ExprPtr operator<=(ExprPtr l, ExprPtr r) { return make_temp<Op_LessEqual>(l, r); }
+ExprPtr operator>=(ExprPtr l, ExprPtr r) { return make_temp<Op_GreaterEqual>(l, r); }
+ExprPtr operator!=(ExprPtr l, ExprPtr r) { return make_temp<Op_NotEqual>(l, r); }
     // Add these implementations
     ExprPtr operator+(ExprPtr l, CellData r) { return l + literal(r); }
     ExprPtr operator+(CellData l, ExprPtr r) { return literal(l) + r; }
@@ -154,23 +245,187 @@ ExprPtr operator>(ExprPtr l, ExprPtr r) { return std::make_shared<Op_Greater>(l,
     ExprPtr operator==(CellData l, ExprPtr r) { return literal(l) == r; }
     ExprPtr operator>(ExprPtr l, CellData r) { return l > literal(r); }
     ExprPtr operator>(CellData l, ExprPtr r) { return literal(l) > r; }
-ExprPtr operator&&(ExprPtr l, ExprPtr r) { return std::make_shared<Op_And>(l, r); }
-ExprPtr operator||(ExprPtr l, ExprPtr r) { return std::make_shared<Op_Or>(l, r); }
-ExprPtr operator!(ExprPtr r) { return std::make_shared<Op_Not>(r); }
+ExprPtr operator&&(ExprPtr l, ExprPtr r) { return make_temp<Op_And>(l, r); }
+ExprPtr operator||(ExprPtr l, ExprPtr r) { return make_temp<Op_Or>(l, r); }
+ExprPtr operator!(ExprPtr r) { return make_temp<Op_Not>(r); }
+ExprPtr operator-(ExprPtr r) {
+    // keep `x > -5` a column-vs-constant predicate the indexes understand
+    if (auto lit = dynamic_cast<Literal*>(r.get()); lit && lit->value.type != DataType::TEXT) {
+        auto negate = [](const CellData& value) { return arithmetic(ArithmeticOp::Subtract, CellData(0), value); };
+        std::optional<CellData> exact;
+        if (lit->exact) exact = negate(*lit->exact);
+        return make_temp<Literal>(negate(lit->value), exact);
+    }
+    return make_temp<Op_Negate>(r);
+}
 
 
 ColRef::ColRef(std::string name) : name(name){}
-Literal::Literal(CellData data): value(data){}
+Literal::Literal(CellData data, std::optional<CellData> exact) : value(data), exact(std::move(exact)) {}
 
 // expr.cpp - add implementations:
 ExprPtr col(std::string name) {
-    return std::make_shared<ColRef>(std::move(name));
+    return make_temp<ColRef>(std::move(name));
+}
+
+ExprPtr literal(CellData value, std::optional<CellData> exact) {
+    return make_temp<Literal>(std::move(value), std::move(exact));
 }
 
-ExprPtr literal(CellData value) {
-    return std::make_shared<Literal>(std::move(value));
+ExprPtr column_value(ExprPtr value, DataType column_type) {
+    auto lit = dynamic_cast<Literal*>(value.get());
+    if (!lit || !lit->exact || column_type != DataType::DECIMAL) return value;
+    return literal(*lit->exact);
 }
 
-CellData Literal::eval(Row row){
+CellData Literal::eval(const Row&) {
     return value;
 }
+
+static std::string constant_str(const CellData& value) {
+    if (value.type != DataType::TEXT) return std::string(value);
+    std::string quoted = "'";
+    for (char c : std::string(value)) quoted += c == '\'' ? "''" : std::string(1, c);
+    return quoted + "'";
+}
+
+std::string Literal::str() {
+    return constant_str(exact ? *exact : value);
+}
+
+ValueSet::ValueSet(const std::vector<CellData>& values) {
+    for (auto& value : values) {
+        texts.insert(std::string(value));
+        if (value.type == DataType::TEXT) has_text = true;
+        else sorted.push_back(value);
+    }
+    if (sorted.size() > SORTED_MAX_VALUES) {
+        numbers.insert(sorted.begin(), sorted.end());
+        sorted.clear();
+    } else {
+        std::sort(sorted.begin(), sorted.end(), [](const CellData& a, const CellData& b) { return a < b; });
+    }
+}
+
+bool ValueSet::contains(const CellData& value) const {
+    if (value.type == DataType::TEXT) return texts.count(std::string(value)) > 0;
+    bool found = numbers.empty()
+        ? std::binary_search(sorted.begin(), sorted.end(), value, [](const CellData& a, const CellData& b) { return a < b; })
+        : numbers.count(value) > 0;
+    // equal text forms mean equal numbers, so this only adds the text members' matches
+    return found || (has_text && texts.count(std::string(value)) > 0);
+}
+
+InList::InList(ExprPtr operand, std::vector<CellData> values)
+    : operand(operand), values(values), set(std::make_shared<ValueSet>(values)) {}
+
+InList::InList(ExprPtr operand, const InList& other) : operand(operand), values(other.values), set(other.set) {}
+
+CellData InList::eval(const Row& row) {
+    return CellData(set->contains(operand->eval(row)));
+}
+
+std::string InList::str() {
+    std::string text = operand_str(operand) + " IN (";
+    for (size_t i = 0; i < values.size(); i++) text += (i ? ", " : "") + constant_str(values[i]);
+    return text + ")";
+}
+
+std::vector<ExprPtr> conjuncts(ExprPtr expr) {
+    if (auto op = dynamic_cast<Op_And*>(expr.get())) {
+        auto result = conjuncts(op->left);
+        auto right = conjuncts(op->right);
+        result.insert(result.end(), right.begin(), right.end());
+        return result;
+    }
+    return {expr};
+}
+
+std::vector<std::string> column_names(ExprPtr expr) {
+    if (auto column = dynamic_cast<ColRef*>(expr.get())) return {column->name};
+    std::vector<std::string> result;
+    if (auto op = dynamic_cast<BinaryOp*>(expr.get())) {
+        result = column_names(op->left);
+        auto right = column_names(op->right);
+        result.insert(result.end(), right.begin(), right.end());
+    } else if (auto op = dynamic_cast<UnaryOp*>(expr.get())) {
+        result = column_names(op->operand);
+    } else if (auto in = dynamic_cast<InList*>(expr.get())) {
+        result = column_names(in->operand);
+    } else if (auto subquery = dynamic_cast<Subquery*>(expr.get()); subquery && subquery->operand.get()) {
+        result = column_names(subquery->operand);  // the subquery's own columns are its business
+    }
+    return result;
+}
+
+ExprPtr rename_columns(ExprPtr expr, const std::function<std::string(const std::string&)>& rename) {
+    if (auto column = dynamic_cast<ColRef*>(expr.get())) return col(rename(column->name));
+    if (auto op = dynamic_cast<BinaryOp*>(expr.get())) {
+        return op->with_operands(rename_columns(op->left, rename), rename_columns(op->right, rename));
+    }
+    if (auto op = dynamic_cast<UnaryOp*>(expr.get())) return op->with_operand(rename_columns(op->operand, rename));
+    if (auto in = dynamic_cast<InList*>(expr.get())) return make_temp<InList>(rename_columns(in->operand, rename), *in);
+    return expr;
+}
+
+ExprPtr conjunction(const std::vector<ExprPtr>& terms) {
+    ExprPtr result;
+    for (auto& term : terms) result = result.get() ? (result && term) : term;
+    return result;
+}
+
+std::optional<ColumnPredicate> column_predicate(ExprPtr expr) {
+    auto op = dynamic_cast<BinaryOp*>(expr.get());
+    if (!op) return std::nullopt;
+
+    std::string name;
+    if (dynamic_cast<Op_Equal*>(op)) name = "=";
+    else if (dynamic_cast<Op_Less*>(op)) name = "<";
+    else if (dynamic_cast<Op_Greater*>(op)) name = ">";
+    else if (dynamic_cast<Op_LessEqual*>(op)) name = "<=";
+    else if (dynamic_cast<Op_GreaterEqual*>(op)) name = ">=";
+    else if (dynamic_cast<Op_NotEqual*>(op)) name = "<>";
+    else return std::nullopt;
+
+    // a bound parameter is as constant as a literal for the current execution
+    auto constant = [](Expr* e) -> std::optional<CellData> {
+        if (auto lit = dynamic_cast<Literal*>(e)) return lit->value;
+        if (auto param = dynamic_cast<Param*>(e)) return param->value();
+        return std::nullopt;
+    };
+    auto column = dynamic_cast<ColRef*>(op->left.get());
+    Expr* side = op->right.get();
+    auto value = constant(side);
+    if (!column || !value) {
+        // constant on the left: mirror the comparison
+        column = dynamic_cast<ColRef*>(op->right.get());
+        side = op->left.get();
+        value = constant(side);
+        if (!column || !value) return std::nullopt;
+        if (name == "<") name = ">";
+        else if (name == ">") name = "<";
+        else if (name == "<=") name = ">=";
+        else if (name == ">=") name = "<=";
+    }
+    auto lit = dynamic_cast<Literal*>(side);
+    return ColumnPredicate{column->name, name, *value, lit ? lit->exact : std::nullopt};
+}
+
+std::optional<std::pair<std::string, std::string>> column_equality(ExprPtr expr) {
+    auto op = dynamic_cast<Op_Equal*>(expr.get());
+    if (!op) return std::nullopt;
+    auto left = dynamic_cast<ColRef*>(op->left.get());
+    auto right = dynamic_cast<ColRef*>(op->right.get());
+    if (!left || !right) return std::nullopt;
+    return std::make_pair(left->name, right->name);
+}
+
+std::optional<std::pair<ExprPtr, ExprPtr>> and_operands(ExprPtr expr) {
+    if (auto op = dynamic_cast<Op_And*>(expr.get())) return std::make_pair(op->left, op->right);
+    return std::nullopt;
+}
+
+std::optional<std::pair<ExprPtr, ExprPtr>> or_operands(ExprPtr expr) {
+    if (auto op = dynamic_cast<Op_Or*>(expr.get())) return std::make_pair(op->left, op->right);
+    return std::nullopt;
+}
@@ -3,14 +3,21 @@
 #define EXPR_H
 
 #include "celldata.hpp"
+#include <functional>
 #include <memory>
+#include <optional>
+#include <unordered_set>
+#include <vector>
 
 class Row;  // Forward declaration
+class Literal;
+struct SelectStatement;
 
 class Expr {
 public:
-   virtual CellData eval(Row row) = 0;
-   virtual bool truthy(Row row);
+   virtual CellData eval(const Row& row) = 0;
+   virtual bool truthy(const Row& row);
+   virtual std::string str() = 0;  // SQL-like text, for EXPLAIN
    virtual ~Expr() = default;
 };
 
@@ -21,12 +28,23 @@ public:
    ExprPtr left;
    ExprPtr right;
    BinaryOp(ExprPtr l, ExprPtr r);
+   std::string str_with(std::string symbol);  // operands parenthesised when they are operators themselves
+   virtual ExprPtr with_operands(ExprPtr l, ExprPtr r) = 0;  // the same operator on other operands
+
+protected:
+   // both operands' values, a number written with a point taken exactly when the other is DECIMAL
+   std::pair<CellData, CellData> operands(const Row& row);
+
+private:
+   const Literal* left_literal = nullptr;
+   const Literal* right_literal = nullptr;
 };
 
 class UnaryOp : public Expr {
 public:
    ExprPtr operand;
    UnaryOp(ExprPtr op);
+   virtual ExprPtr with_operand(ExprPtr op) = 0;
 };
 
 // Operation classes declarations
@@ -34,8 +52,10 @@ public:
 class ColRef : public Expr {
 public:
    std::string name;
+   size_t position = 0;  // where `name` was found last time; checked before use
    ColRef(std::string n);
-   CellData eval(Row row) override;
+   CellData eval(const Row& row) override;
+   std::string str() override { return name; }
     
     virtual ~ColRef() = default;
 };
@@ -43,14 +63,98 @@ public:
 class Literal : public Expr {
 public:
    CellData value;
-   Literal(CellData v);
-   CellData eval(Row row) override;
+   std::optional<CellData> exact;  // the DECIMAL a number written with a point spells
+   Literal(CellData v, std::optional<CellData> exact = std::nullopt);
+   // the value to use next to one of the given type
+   const CellData& against(DataType other) const { return other == DataType::DECIMAL && exact ? *exact : value; }
+   CellData eval(const Row& row) override;
+   std::string str() override;
     
      virtual ~Literal() = default;
 };
 
+using ParamValues = std::vector<std::optional<CellData>>;
+
+// `?` placeholder of a prepared statement; evaluates to whatever is bound to it.
+class Param : public Expr {
+public:
+   std::shared_ptr<ParamValues> values;  // shared by all placeholders of the statement
+   size_t index;
+   Param(std::shared_ptr<ParamValues> values, size_t index);
+   CellData value();
+   CellData eval(const Row& row) override;
+   std::string str() override { return "?"; }
+};
+
+// Constants of an IN list, built once so each row costs a single probe: a binary
+// search for a short list of numbers, a hash lookup otherwise. Text compares
+// with anything as text, so every value is also kept in its text form.
+struct ValueSet {
+    static constexpr size_t SORTED_MAX_VALUES = 16;
+
+    std::vector<CellData> sorted;  // the numbers, when there are few of them
+    std::unordered_set<CellData, CellDataHash, CellDataEqual> numbers;  // the numbers otherwise
+    std::unordered_set<std::string> texts;
+    bool has_text = false;
+
+    explicit ValueSet(const std::vector<CellData>& values);
+    bool contains(const CellData& value) const;
+};
+
+class InList : public Expr {
+public:
+   ExprPtr operand;
+   std::vector<CellData> values;  // as written
+   std::shared_ptr<const ValueSet> set;
+   InList(ExprPtr operand, std::vector<CellData> values);
+   InList(ExprPtr operand, const InList& other);  // the same list for another operand
+   CellData eval(const Row& row) override;
+   std::string str() override;
+};
+
+// `operand [NOT] IN (SELECT ...)` or `[NOT] EXISTS (SELECT ...)` over a query that
+// reads nothing of the outer row. The planner runs it once, as a semi-join (an
+// anti-join when negated), so it is never evaluated row by row.
+class Subquery : public Expr {
+public:
+   ExprPtr operand;  // null for EXISTS
+   std::shared_ptr<SelectStatement> query;
+   bool negated = false;
+   Subquery(ExprPtr operand, std::shared_ptr<SelectStatement> query);
+   CellData eval(const Row& row) override;  // throws: only AND-ed WHERE terms are planned
+   std::string str() override;
+};
+
 ExprPtr col(std::string name);
-ExprPtr literal(CellData value);
+ExprPtr literal(CellData value, std::optional<CellData> exact = std::nullopt);
+// the expression to store in a column of the given type: a number written with a
+// point goes into a DECIMAL column exactly
+ExprPtr column_value(ExprPtr value, DataType column_type);
+
+// `column <op> constant` with the column normalised to the left; the shape that
+// table indexes can answer without evaluating every row.
+struct ColumnPredicate {
+    std::string column;
+    std::string op;
+    CellData value;
+    std::optional<CellData> exact;  // as in Literal
+
+    const CellData& against(DataType column_type) const {
+        return column_type == DataType::DECIMAL && exact ? *exact : value;
+    }
+};
+
+std::vector<ExprPtr> conjuncts(ExprPtr expr);
+std::vector<std::string> column_names(ExprPtr expr);  // every column the expression reads
+// A copy with each column name replaced by rename(name); constants are shared.
+ExprPtr rename_columns(ExprPtr expr, const std::function<std::string(const std::string&)>& rename);
+ExprPtr conjunction(const std::vector<ExprPtr>& terms);  // the terms AND-ed; null when there are none
+std::optional<ColumnPredicate> column_predicate(ExprPtr expr);
+// the two column names of a `column = column` comparison, as joins use
+std::optional<std::pair<std::string, std::string>> column_equality(ExprPtr expr);
+// operands of a top-level AND / OR
+std::optional<std::pair<ExprPtr, ExprPtr>> and_operands(ExprPtr expr);
+std::optional<std::pair<ExprPtr, ExprPtr>> or_operands(ExprPtr expr);
 
 ExprPtr operator+(ExprPtr l, ExprPtr r);
 ExprPtr operator-(ExprPtr l, ExprPtr r);
@@ -59,9 +163,13 @@ ExprPtr operator/(ExprPtr l, ExprPtr r);
 ExprPtr operator<(ExprPtr l, ExprPtr r);
 ExprPtr operator==(ExprPtr l, ExprPtr r);
 ExprPtr operator>(ExprPtr l, ExprPtr r);
+ExprPtr operator<=(ExprPtr l, ExprPtr r);
+ExprPtr operator>=(ExprPtr l, ExprPtr r);
+ExprPtr operator!=(ExprPtr l, ExprPtr r);
 ExprPtr operator&&(ExprPtr l, ExprPtr r);
 ExprPtr operator||(ExprPtr l, ExprPtr r);
 ExprPtr operator!(ExprPtr r);
+ExprPtr operator-(ExprPtr r);  // folds into the literal when negating a number
 
 // Add these declarations
 ExprPtr operator+(ExprPtr l, CellData r);
@@ -0,0 +1,96 @@
+#include "hash_index.hpp"
+#include <algorithm>
+#include <bit>
+
+CellData HashIndex::key_of(const std::vector<Row>& rows, RowRef row) const {
+    return rows[row].cells.elements[column].value;
+}
+
+std::optional<HashIndex::RowRef> HashIndex::find(const std::vector<Row>& rows, CellData key) const {
+    if (slots.empty()) return std::nullopt;
+    size_t h = key.hash();
+    size_t mask = slots.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        const Slot& slot = slots[i];
+        if (slot.state == SlotState::EMPTY) return std::nullopt;
+        if (slot.state == SlotState::FULL && slot.hash == h && (key_of(rows, slot.row) <=> key) == 0) {
+            return slot.row;
+        }
+    }
+}
+
+bool HashIndex::insert(const std::vector<Row>& rows, CellData key, RowRef row) {
+    // Keep the load factor (tombstones included) under 3/4 so probes stay short
+    if ((used + 1) * 4 > slots.size() * 3) {
+        rehash(std::max<size_t>(16, std::bit_ceil((count + 1) * 2)));
+    }
+    size_t h = key.hash();
+    size_t mask = slots.size() - 1;
+    std::optional<size_t> reuse;
+    size_t i = h & mask;
+    for (;; i = (i + 1) & mask) {
+        Slot& slot = slots[i];
+        if (slot.state == SlotState::EMPTY) break;
+        if (slot.state == SlotState::DELETED) {
+            if (!reuse) reuse = i;
+        } else if (slot.hash == h && (key_of(rows, slot.row) <=> key) == 0) {
+            return false;
+        }
+    }
+    if (reuse) {
+        i = *reuse;
+    } else {
+        used++;
+    }
+    slots[i] = Slot{h, SlotState::FULL, row};
+    count++;
+    return true;
+}
+
+bool HashIndex::erase(const std::vector<Row>& rows, CellData key) {
+    if (slots.empty()) return false;
+    size_t h = key.hash();
+    size_t mask = slots.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        Slot& slot = slots[i];
+        if (slot.state == SlotState::EMPTY) return false;
+        if (slot.state == SlotState::FULL && slot.hash == h && (key_of(rows, slot.row) <=> key) == 0) {
+            slot.state = SlotState::DELETED;
+            count--;
+            return true;
+        }
+    }
+}
+
+void HashIndex::clear() {
+    slots.clear();
+    count = 0;
+    used = 0;
+}
+
+void HashIndex::rehash(size_t capacity) {
+    std::vector<Slot> old = std::move(slots);
+    slots.assign(capacity, Slot());
+    used = count;
+    size_t mask = capacity - 1;
+    for (auto& slot : old) {
+        if (slot.state != SlotState::FULL) continue;
+        size_t i = slot.hash & mask;
+        while (slots[i].state != SlotState::EMPTY) i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+}
+
+void HashIndex::close_gaps(const std::vector<RowRef>& removed) {
+    if (removed.empty()) return;
+    for (auto& slot : slots) {
+        if (slot.state != SlotState::FULL || slot.row < removed.front()) continue;
+        slot.row -= std::lower_bound(removed.begin(), removed.end(), slot.row) - removed.begin();
+    }
+}
+
+void HashIndex::reserve(size_t extra) {
+    if ((used + extra) * 4 > slots.size() * 3) {
+        rehash(std::max<size_t>(16, std::bit_ceil((count + extra) * 2)));
+    }
+}
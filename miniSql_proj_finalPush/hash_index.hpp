@@ -0,0 +1,43 @@
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include "row.hpp"
+#include <optional>
+
+// Open-addressing (linear probing) index from a key column to the row holding it.
+// Slots only keep the key hash and the row's position; keys are compared against
+// the row itself, so the index never duplicates cell data.
+class HashIndex {
+public:
+    using RowRef = size_t;
+
+    enum class SlotState : unsigned char { EMPTY, FULL, DELETED };
+
+    struct Slot {
+        size_t hash = 0;
+        SlotState state = SlotState::EMPTY;
+        RowRef row = 0;
+    };
+
+    size_t column = 0;  // position of the key column inside each row
+    std::vector<Slot> slots;
+    size_t count = 0;   // FULL slots
+    size_t used = 0;    // FULL + DELETED slots, drives rehashing
+
+    HashIndex() = default;
+    HashIndex(size_t column) : column(column) {}
+
+    std::optional<RowRef> find(const std::vector<Row>& rows, CellData key) const;
+    bool insert(const std::vector<Row>& rows, CellData key, RowRef row);  // false if the key is already present
+    bool erase(const std::vector<Row>& rows, CellData key);
+    void clear();
+
+    CellData key_of(const std::vector<Row>& rows, RowRef row) const;
+    void rehash(size_t capacity);
+    void reserve(size_t extra);  // room for `extra` more keys without rehashing
+    // Renumbers the rows after the removed positions (sorted, already erased) the
+    // way removing them from the table moves them down.
+    void close_gaps(const std::vector<RowRef>& removed);
+};
+
+#endif
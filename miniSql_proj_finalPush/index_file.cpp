@@ -0,0 +1,355 @@
+#include "index_file.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// Layout (native endianness, every field 8-byte aligned):
+//   magic, hash fingerprint, stamp
+//   has_pk [column, slot count, count, used, slots...]
+//   bitmap index count, per index: column, value count,
+//     per value: key, container count, per container: key, cardinality, dense, payload
+static const char INDEX_MAGIC[8] = {'M', 'D', 'B', 'I', 'D', 'X', '0', '1'};
+
+// Statistics file layout, same encoding:
+//   magic, hash fingerprint, stamp, analyzed row count, changes since, column count,
+//   per column: register count, registers, min, max, bound count, bounds
+static const char STATS_MAGIC[8] = {'M', 'D', 'B', 'S', 'T', 'A', '0', '1'};
+
+// Slots store hashes, which are only meaningful for the standard library that made them
+static uint64_t hash_fingerprint() {
+    return CellData("minidb").hash() ^ (CellData(12345).hash() << 1) ^ (CellData(0.5).hash() << 2);
+}
+
+IndexStamp stamp_table_file(std::string csv_path, size_t row_count) {
+    IndexStamp stamp;
+    std::error_code ec;
+    stamp.file_size = fs::file_size(csv_path, ec);
+    stamp.file_mtime = fs::last_write_time(csv_path, ec).time_since_epoch().count();
+    stamp.row_count = row_count;
+    return stamp;
+}
+
+namespace {
+
+class IndexWriter {
+public:
+    std::ofstream out;
+
+    IndexWriter(std::string path) : out(path, std::ios::binary | std::ios::trunc) {}
+
+    void u64(uint64_t value) { out.write(reinterpret_cast<char*>(&value), sizeof(value)); }
+
+    void bytes(const void* data, size_t size) {
+        out.write(static_cast<const char*>(data), size);
+        static const char zeros[8] = {};
+        if (size % 8) out.write(zeros, 8 - size % 8);
+    }
+
+    void cell(CellData value) {
+        u64(static_cast<uint64_t>(value.type));
+        switch (value.type) {
+            case DataType::INTEGER: u64(static_cast<uint64_t>(int(value))); break;
+            case DataType::FLOAT: { double d = double(value); bytes(&d, sizeof(d)); break; }
+            case DataType::TEXT: {
+                std::string text = value;
+                u64(text.size());
+                bytes(text.data(), text.size());
+                break;
+            }
+            case DataType::BIGINT: u64(static_cast<uint64_t>(value.unscaled())); break;
+            case DataType::DECIMAL:
+                u64(static_cast<uint64_t>(value.unscaled()));
+                u64(static_cast<uint64_t>(value.scale()));
+                break;
+        }
+    }
+};
+
+class IndexReader {
+public:
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+    bool ok = true;
+
+    bool take(void* dest, size_t n) {
+        size_t padded = (n + 7) / 8 * 8;
+        if (!ok || pos + padded > size) return ok = false;
+        std::memcpy(dest, data + pos, n);
+        pos += padded;
+        return true;
+    }
+
+    uint64_t u64() {
+        uint64_t value = 0;
+        take(&value, sizeof(value));
+        return value;
+    }
+
+    CellData cell() {
+        switch (static_cast<DataType>(u64())) {
+            case DataType::INTEGER: return CellData(static_cast<int>(u64()));
+            case DataType::FLOAT: { double d = 0; take(&d, sizeof(d)); return CellData(d); }
+            case DataType::TEXT: {
+                uint64_t length = u64();
+                if (length > size) { ok = false; return CellData(""); }
+                std::string text(length, '\0');
+                take(text.data(), length);
+                return CellData(text);
+            }
+            case DataType::BIGINT: return CellData::bigint(static_cast<int64_t>(u64()));
+            case DataType::DECIMAL: {
+                int64_t unscaled = static_cast<int64_t>(u64());
+                uint64_t scale = u64();
+                if (scale > CellData::MAX_DECIMAL_DIGITS) break;
+                return CellData::decimal(unscaled, int(scale));
+            }
+        }
+        ok = false;
+        return CellData(0);
+    }
+};
+
+// Read-only mapping of a whole file; empty when the file is missing.
+class MappedFile {
+public:
+    const char* data = nullptr;
+    size_t size = 0;
+
+    MappedFile(std::string path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data = static_cast<const char*>(mapped);
+                size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+    ~MappedFile() {
+        if (data) munmap(const_cast<char*>(data), size);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+}
+
+// Scans answer from containers without checking them, so one read from disk must
+// be well formed: array entries sorted and unique, the cardinality equal to the ids
+// held, none of them empty and every id a row of the table.
+static bool valid_container(const Bitmap::Container& c, size_t row_count) {
+    size_t highest = 0;
+    if (c.dense()) {
+        size_t count = 0;
+        for (size_t w = 0; w < Bitmap::WORDS; w++) {
+            count += std::popcount(c.bits[w]);
+            if (c.bits[w]) highest = w * 64 + 63 - std::countl_zero(c.bits[w]);
+        }
+        if (count != c.cardinality) return false;
+    } else {
+        if (std::adjacent_find(c.array.begin(), c.array.end(), std::greater_equal<uint16_t>()) != c.array.end()) return false;
+        if (!c.array.empty()) highest = c.array.back();
+    }
+    return c.cardinality > 0 && (size_t(c.key) << 16) + highest < row_count;
+}
+
+void write_index_file(Table& table, std::string path, IndexStamp stamp) {
+    IndexWriter w(path);
+    w.bytes(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    w.u64(hash_fingerprint());
+    w.u64(stamp.file_size);
+    w.u64(static_cast<uint64_t>(stamp.file_mtime));
+    w.u64(stamp.row_count);
+
+    w.u64(!table.primary_key.empty());
+    if (!table.primary_key.empty()) {
+        auto& index = *table.pk_index;
+        w.u64(index.column);
+        w.u64(index.slots.size());
+        w.u64(index.count);
+        w.u64(index.used);
+        for (auto& slot : index.slots) {
+            w.u64(slot.hash);
+            w.u64(slot.row);
+            w.u64(static_cast<uint64_t>(slot.state));
+        }
+    }
+
+    w.u64(table.bitmap_indexes->size());
+    for (auto& index : *table.bitmap_indexes) {
+        w.u64(index.column);
+        w.u64(index.values.size());
+        for (auto& [value, bitmap] : index.values) {
+            w.cell(value);
+            w.u64(bitmap.containers.size());
+            for (auto& c : bitmap.containers) {
+                w.u64(c.key);
+                w.u64(c.cardinality);
+                w.u64(c.dense());
+                if (c.dense()) w.bytes(c.bits.data(), c.bits.size() * sizeof(uint64_t));
+                else w.bytes(c.array.data(), c.array.size() * sizeof(uint16_t));
+            }
+        }
+    }
+}
+
+bool read_index_file(Table& table, std::string path, IndexStamp stamp) {
+    MappedFile file(path);
+    if (!file.data) return false;
+    IndexReader r{file.data, file.size};
+
+    char magic[sizeof(INDEX_MAGIC)];
+    r.take(magic, sizeof(magic));
+    if (!r.ok || std::memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0) return false;
+    if (r.u64() != hash_fingerprint()) return false;
+    if (r.u64() != stamp.file_size || static_cast<int64_t>(r.u64()) != stamp.file_mtime ||
+        r.u64() != stamp.row_count) {
+        return false;
+    }
+
+    HashIndex pk_index;
+    bool has_pk = r.u64();
+    if (has_pk != !table.primary_key.empty()) return false;
+    if (has_pk) {
+        pk_index = HashIndex(r.u64());
+        if (pk_index.column != table.column_index(table.primary_key)) return false;
+        uint64_t slot_count = r.u64();
+        if (slot_count > file.size / 24 || (slot_count & (slot_count - 1))) return false;
+        r.u64();  // count and used are recounted from the slots
+        r.u64();
+        pk_index.slots.resize(slot_count);
+        // lookups trust the slots, so each row must be in exactly one whose hash is its key's
+        std::vector<bool> indexed(table.rows->size());
+        for (auto& slot : pk_index.slots) {
+            slot.hash = r.u64();
+            slot.row = r.u64();
+            uint64_t state = r.u64();
+            if (state > uint64_t(HashIndex::SlotState::DELETED)) return false;
+            slot.state = static_cast<HashIndex::SlotState>(state);
+            if (slot.state == HashIndex::SlotState::EMPTY) continue;
+            pk_index.used++;
+            if (slot.state == HashIndex::SlotState::DELETED) continue;
+            if (slot.row >= table.rows->size() || indexed[slot.row]) return false;
+            if (slot.hash != pk_index.key_of(*table.rows, slot.row).hash()) return false;
+            indexed[slot.row] = true;
+            pk_index.count++;
+        }
+        // a probe only stops at an empty slot
+        if (pk_index.count != table.rows->size() || (slot_count && pk_index.used >= slot_count)) return false;
+    }
+
+    std::vector<BitmapIndex> bitmap_indexes;
+    if (r.u64() != table.bitmap_indexes->size()) return false;
+    for (auto& declared : *table.bitmap_indexes) {
+        BitmapIndex index(r.u64());
+        if (index.column != declared.column) return false;
+        uint64_t value_count = r.u64();
+        for (uint64_t v = 0; v < value_count && r.ok; v++) {
+            CellData value = r.cell();
+            if (index.values.count(value)) return false;
+            Bitmap& bitmap = index.values[value];
+            uint64_t container_count = r.u64();
+            if (container_count > file.size) return false;
+            bitmap.containers.resize(container_count);
+            for (auto& c : bitmap.containers) {
+                uint64_t key = r.u64();
+                if (key > UINT32_MAX) return false;
+                c.key = static_cast<uint32_t>(key);
+                if (&c != &bitmap.containers.front() && (&c - 1)->key >= c.key) return false;
+                c.cardinality = r.u64();
+                if (c.cardinality > 65536) return false;
+                if (r.u64()) {
+                    c.bits.resize(Bitmap::WORDS);
+                    r.take(c.bits.data(), c.bits.size() * sizeof(uint64_t));
+                } else {
+                    c.array.resize(c.cardinality);
+                    r.take(c.array.data(), c.array.size() * sizeof(uint16_t));
+                }
+                if (r.ok && !valid_container(c, table.rows->size())) return false;
+            }
+        }
+        bitmap_indexes.push_back(std::move(index));
+    }
+    if (!r.ok) return false;
+
+    table.pk_index = std::move(pk_index);
+    table.bitmap_indexes = std::move(bitmap_indexes);
+    return true;
+}
+
+void write_stats_file(Table& table, std::string path, IndexStamp stamp) {
+    IndexWriter w(path);
+    w.bytes(STATS_MAGIC, sizeof(STATS_MAGIC));
+    w.u64(hash_fingerprint());
+    w.u64(stamp.file_size);
+    w.u64(static_cast<uint64_t>(stamp.file_mtime));
+    w.u64(stamp.row_count);
+
+    auto& stats = *table.stats;
+    w.u64(stats.analyzed_rows);
+    w.u64(stats.changes);
+    w.u64(stats.columns.size());
+    for (auto& column : stats.columns) {
+        w.u64(column.distinct.registers.size());
+        w.bytes(column.distinct.registers.data(), column.distinct.registers.size());
+        w.u64(column.has_range);
+        if (column.has_range) {
+            w.cell(column.min);
+            w.cell(column.max);
+        }
+        w.u64(column.bounds.size());
+        for (auto& bound : column.bounds) w.cell(bound);
+    }
+}
+
+bool read_stats_file(Table& table, std::string path, IndexStamp stamp) {
+    MappedFile file(path);
+    if (!file.data) return false;
+    IndexReader r{file.data, file.size};
+
+    char magic[sizeof(STATS_MAGIC)];
+    r.take(magic, sizeof(magic));
+    if (!r.ok || std::memcmp(magic, STATS_MAGIC, sizeof(magic)) != 0) return false;
+    if (r.u64() != hash_fingerprint()) return false;
+    if (r.u64() != stamp.file_size || static_cast<int64_t>(r.u64()) != stamp.file_mtime ||
+        r.u64() != stamp.row_count) {
+        return false;
+    }
+
+    TableStats stats;
+    stats.analyzed = true;
+    stats.analyzed_rows = r.u64();
+    stats.changes = r.u64();
+    if (r.u64() != table.schema.size()) return false;
+    for (size_t c = 0; c < table.schema.size() && r.ok; c++) {
+        ColumnStats column;
+        if (r.u64() != column.distinct.registers.size()) return false;
+        r.take(column.distinct.registers.data(), column.distinct.registers.size());
+        column.has_range = r.u64();
+        if (column.has_range) {
+            column.min = r.cell();
+            column.max = r.cell();
+        }
+        uint64_t bound_count = r.u64();
+        if (bound_count > TableStats::HISTOGRAM_BUCKETS) return false;
+        for (uint64_t b = 0; b < bound_count && r.ok; b++) column.bounds.push_back(r.cell());
+        stats.columns.push_back(std::move(column));
+    }
+    if (!r.ok) return false;
+
+    table.stats = std::move(stats);
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef INDEX_FILE_H
+#define INDEX_FILE_H
+
+#include "table.hpp"
+#include <cstdint>
+
+// Identifies the table file an index file was built from. An index file whose
+// stamp differs from the table file on disk is stale and gets rebuilt.
+struct IndexStamp {
+    uint64_t file_size = 0;
+    int64_t file_mtime = 0;
+    uint64_t row_count = 0;
+};
+
+IndexStamp stamp_table_file(std::string csv_path, size_t row_count);
+
+// Serialises the primary key slots and bitmap containers of `table` next to its CSV.
+void write_index_file(Table& table, std::string path, IndexStamp stamp);
+// Maps the index file and copies its indexes into the table if it matches `stamp` and
+// the indexes the table declares; loading skips rehashing and re-adding every row, but
+// the indexes still live on the heap. Returns false (leaving the table untouched) when
+// it has to be rebuilt, including when a primary key slot doesn't match its row.
+bool read_index_file(Table& table, std::string path, IndexStamp stamp);
+
+// ANALYZE statistics get a file of their own, stamped the same way; stale ones
+// are dropped and the table is simply not analyzed until the next ANALYZE.
+void write_stats_file(Table& table, std::string path, IndexStamp stamp);
+bool read_stats_file(Table& table, std::string path, IndexStamp stamp);
+
+#endif
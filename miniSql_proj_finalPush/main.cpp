@@ -1,8 +1,7 @@
 #include "sql_handle.hpp"
-#include "csv_manip.hpp"
+#include "bench.hpp"
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <stdexcept>
 #include <string>
 
@@ -24,40 +23,42 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " input.sql output.txt\n";
+    if (argc >= 2 && std::string(argv[1]) == "bench") {
+        return run_benchmarks(argc, argv);
+    }
+
+    // input.sql output.txt [--stats]: --stats also writes output.txt.stats.json
+    bool write_stats = argc == 4 && std::string(argv[3]) == "--stats";
+    if (argc != 3 && !write_stats) {
+        std::cerr << "Usage: " << argv[0] << " input.sql output.txt [--stats]\n";
         std::cerr << "   or: " << argv[0] << " test\n";
         std::cerr << "   or: " << argv[0] << " test2\n";
+        std::cerr << "   or: " << argv[0] << " bench [--rows 1000,10000] [--types INTEGER,FLOAT,TEXT]"
+                     " [--text-cardinality N] [--seed N] [--out results.json]\n";
         return 1;
     }
 
+    SqlInterpreter interpreter;
+    int status = 0;
     try {
-        std::ifstream sql_file(argv[1], std::ios::binary);
-        if (!sql_file) {
-            throw std::runtime_error("Could not open input file " + std::string(argv[1]));
-        }
-        std::stringstream buffer;
-        buffer << sql_file.rdbuf();
-        
         std::ofstream output(argv[2]);
         if (!output) {
             throw std::runtime_error("Could not open output file " + std::string(argv[2]));
         }
 
-        SqlInterpreter interpreter;
-        interpreter.execute(buffer.str());
-
-        // Simplified output handling
-        for (const auto& table : interpreter.outputTables) {
-            output << csv_dumps(table, false, true);
-            output << "---\n";
-        }
-
+        interpreter.set_output(output);
+        interpreter.execute_file(argv[1]);
+        interpreter.output = nullptr;
 
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
-        return 1;
+        interpreter.output = nullptr;
+        status = 1;
     }
 
-    return 0;
+    if (write_stats) {
+        std::ofstream stats(std::string(argv[2]) + ".stats.json");
+        write_stats_json(stats, interpreter.statement_stats);
+    }
+    return status;
 }
@@ -20,6 +20,11 @@ public:
         if(index >= elements.size()) throw std::out_of_range("Index out of range");
         return elements[index].value;
     }
+
+    const T& operator[](size_t index) const {
+        if(index >= elements.size()) throw std::out_of_range("Index out of range");
+        return elements[index].value;
+    }
     
     T& operator[](std::string name) {
         for(auto& elem : elements) {
@@ -0,0 +1,611 @@
+#include "plan.hpp"
+#include "arena.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+Table RowSet::materialize(std::vector<std::string> cols) {
+    Table result = table.gather(cols, ids);
+    result.name = table.name;
+    return result;
+}
+
+RowSet PlanNode::execute(bool analyze) {
+    if (!analyze) return produce(false);
+    auto start = StatsClock::now();
+    uint64_t allocated = allocated_bytes();
+    RowSet result = produce(true);
+    analyzed = true;
+    actual_ms = elapsed_ms(start);
+    actual_bytes = allocated_bytes() - allocated;
+    actual_rows = result.size();
+    return result;
+}
+
+// The input's positions, spelling out "every row" for the operators that change them.
+static std::vector<size_t> selected_rows(RowSet input) {
+    if (input.ids) return std::move(*input.ids);
+    std::vector<size_t> all(input.table.rows->size());
+    std::iota(all.begin(), all.end(), 0);
+    return all;
+}
+
+ScanNode::ScanNode(Table& table, ExprPtr condition) : table(table) {
+    estimated_rows = double(table.rows->size());
+    if (condition.get() == nullptr) return;  // ExprPtr overloads !, so test the pointer itself
+    auto planning = StatsClock::now();
+    this->condition = order_conjuncts(condition, table.stats_lookup());
+    estimated_rows = table.estimate_rows(this->condition);
+    path = table.access_path(this->condition);
+    if (current_stats) current_stats->plan_ms += elapsed_ms(planning);
+}
+
+std::string ScanNode::describe() {
+    std::string text = "Scan " + table.name;
+    if (condition.get() != nullptr) {
+        if (path.kind == AccessPath::Kind::PrimaryKey) text = "PrimaryKeyLookup " + table.name;
+        if (path.kind == AccessPath::Kind::Bitmap) text = "BitmapLookup " + table.name;
+        text += " where " + condition->str();
+        if (!path.zone_preds.empty()) {
+            text += " (zone maps on";
+            for (size_t i = 0; i < path.zone_preds.size(); i++) {
+                text += (i ? ", " : " ") + table.schema.elements[path.zone_preds[i].first].name;
+            }
+            text += ")";
+        }
+    }
+    if (!filter_column.empty()) text += " (bloom filter on " + filter_column + ")";
+    return text;
+}
+
+RowSet ScanNode::produce(bool) {  // a leaf: nothing below it to analyze
+    std::optional<std::vector<size_t>> ids;
+    if (condition.get() != nullptr) {
+        if (!path_fresh) {
+            auto planning = StatsClock::now();
+            path = table.access_path(condition);
+            if (current_stats) current_stats->plan_ms += elapsed_ms(planning);
+        }
+        path_fresh = false;
+        ids = table.matching_rows(condition, path);
+    }
+    if (!runtime_filter) return {table, ids};
+    size_t column = table.column_index(filter_column);
+    std::vector<size_t> kept;
+    auto keep = [&](size_t id) {
+        if (runtime_filter->may_contain((*table.rows)[id].cells.elements[column].value)) kept.push_back(id);
+    };
+    if (ids) {
+        for (auto id : *ids) keep(id);
+    } else {
+        for (size_t id = 0; id < table.rows->size(); id++) keep(id);
+        if (current_stats) current_stats->rows_scanned += table.rows->size();
+    }
+    return {table, kept};
+}
+
+FilterNode::FilterNode(PlanPtr input, ExprPtr condition, const ColumnStatsLookup& stats)
+    : condition(order_conjuncts(condition, stats)) {
+    children.push_back(input);
+    estimated_rows = input->estimated_rows * estimate_selectivity(this->condition, stats);
+}
+
+std::string FilterNode::describe() {
+    return "Filter " + condition->str();
+}
+
+RowSet FilterNode::produce(bool analyze) {
+    RowSet input = children[0]->execute(analyze);
+    if (!input.ids) return {input.table, input.table.matching_rows(condition)};
+    std::vector<size_t> kept;
+    for (auto id : *input.ids) {
+        if (condition->truthy((*input.table.rows)[id])) kept.push_back(id);
+    }
+    if (current_stats) current_stats->rows_scanned += input.ids->size();
+    return {input.table, kept};
+}
+
+NestedLoopJoinNode::NestedLoopJoinNode(PlanPtr left, PlanPtr right) {
+    children = {left, right};
+    estimated_rows = left->estimated_rows * right->estimated_rows;
+}
+
+std::string NestedLoopJoinNode::describe() {
+    return "NestedLoopJoin";
+}
+
+RowSet NestedLoopJoinNode::produce(bool analyze) {
+    Table left = children[0]->execute(analyze).materialize();
+    Table right = children[1]->execute(analyze).materialize();
+    return {left.join(right), std::nullopt};
+}
+
+HashJoinNode::HashJoinNode(PlanPtr left, PlanPtr right, std::string left_key, std::string right_key,
+                           const ColumnStatsLookup& stats)
+    : left_key(left_key), right_key(right_key) {
+    children = {left, right};
+    build_left = left->estimated_rows < right->estimated_rows;
+    double matches = estimate_selectivity(col(left_key) == col(right_key), stats);
+    estimated_rows = left->estimated_rows * right->estimated_rows * matches;
+
+    // a build side holding few of the values the probe side's key column has is
+    // worth a bloom filter in the probe side's scan
+    auto probe = std::dynamic_pointer_cast<ScanNode>(build_left ? right : left);
+    if (!probe) return;
+    std::string probe_key = build_left ? right_key : left_key;
+    auto column = stats(probe_key);
+    double probe_values = column ? column->distinct_values() : double(probe->table.rows->size());
+    if ((build_left ? left : right)->estimated_rows < BLOOM_MAX_KEY_FRACTION * probe_values) {
+        probe_scan = probe;
+        probe->filter_column = probe_key.substr(probe->table.name.size() + 1);
+    }
+}
+
+std::string HashJoinNode::describe() {
+    return "HashJoin " + left_key + " = " + right_key + (build_left ? " (build left)" : " (build right)");
+}
+
+// Position of a join condition's column in an input: columns of a single table
+// are named without the table prefix the condition uses.
+static size_t key_position(Table& table, const std::string& key) {
+    std::string prefix = table.name + ".";
+    if (!table.isJoinedTable && key.compare(0, prefix.size(), prefix) == 0) {
+        return table.column_index(key.substr(prefix.size()));
+    }
+    return table.column_index(key);
+}
+
+// Positions 0..groups.size()-1 listed group by group, each group's in order, with
+// `start[g]` where group g begins; every size is known before anything is stored,
+// so nothing in the statement arena is grown (and abandoned) along the way.
+namespace {
+struct Grouped {
+    std::pmr::vector<size_t> start, positions;
+
+    Grouped(const std::pmr::vector<size_t>& groups, size_t group_count)
+        : start(group_count + 1, 0, temp_memory()), positions(temp_memory()) {
+        for (auto g : groups) if (g < group_count) start[g + 1]++;
+        for (size_t g = 0; g < group_count; g++) start[g + 1] += start[g];
+        positions.resize(start[group_count]);
+        std::pmr::vector<size_t> next(start.begin(), start.end() - 1, temp_memory());
+        for (size_t i = 0; i < groups.size(); i++) {
+            if (groups[i] < group_count) positions[next[groups[i]]++] = i;
+        }
+    }
+    size_t size(size_t g) const { return start[g + 1] - start[g]; }
+};
+}
+
+RowSet HashJoinNode::produce(bool analyze) {
+    // the build side runs first so that its keys can filter the probe side's scan
+    Table build = children[build_left ? 0 : 1]->execute(analyze).materialize();
+    size_t build_at = key_position(build, build_left ? left_key : right_key);
+    // each distinct build key is numbered, and the probe rows are given the number of theirs
+    std::pmr::unordered_map<CellData, size_t, CellDataHash, CellDataEqual> keys(temp_memory());
+    keys.reserve(build.rows->size());
+    std::pmr::vector<size_t> build_groups(build.rows->size(), temp_memory());
+    for (size_t i = 0; i < build.rows->size(); i++) {
+        build_groups[i] = keys.try_emplace((*build.rows)[i].cells.elements[build_at].value, keys.size()).first->second;
+    }
+    if (probe_scan) {
+        auto filter = std::make_shared<BloomFilter>(keys.size());
+        for (auto& key : keys) filter->add(key.first);
+        probe_scan->runtime_filter = filter;
+    }
+    Table probe = children[build_left ? 1 : 0]->execute(analyze).materialize();
+    if (probe_scan) probe_scan->runtime_filter = nullptr;
+    size_t probe_at = key_position(probe, build_left ? right_key : left_key);
+    std::pmr::vector<size_t> probe_groups(probe.rows->size(), keys.size(), temp_memory());  // keys.size(): no match
+    for (size_t i = 0; i < probe.rows->size(); i++) {
+        auto found = keys.find((*probe.rows)[i].cells.elements[probe_at].value);
+        if (found != keys.end()) probe_groups[i] = found->second;
+    }
+
+    // output in left row order, each left row's matches in right row order
+    JoinBuilder joined(build_left ? build : probe, build_left ? probe : build);
+    auto& left_groups = build_left ? build_groups : probe_groups;
+    Grouped right(build_left ? probe_groups : build_groups, keys.size());
+    size_t matches = 0;
+    for (auto g : left_groups) matches += g < keys.size() ? right.size(g) : 0;
+    joined.result.rows.edit().reserve(matches);
+    for (size_t i = 0; i < left_groups.size(); i++) {
+        if (left_groups[i] == keys.size()) continue;
+        for (size_t k = right.start[left_groups[i]]; k < right.start[left_groups[i] + 1]; k++) {
+            joined.add(i, right.positions[k]);
+        }
+    }
+    return {std::move(joined.result), std::nullopt};
+}
+
+MergeJoinNode::MergeJoinNode(PlanPtr left, PlanPtr right, std::string left_key, std::string right_key,
+                             const ColumnStatsLookup& stats)
+    : left_key(left_key), right_key(right_key) {
+    children = {left, right};
+    double matches = estimate_selectivity(col(left_key) == col(right_key), stats);
+    estimated_rows = left->estimated_rows * right->estimated_rows * matches;
+}
+
+std::string MergeJoinNode::describe() {
+    return "MergeJoin " + left_key + " = " + right_key;
+}
+
+// The input's row positions ordered by the column (ties in input order); empty
+// when the input already is, so that it can be read in place.
+static std::vector<size_t> key_order(const RowSet& input, size_t column) {
+    auto row = [&](size_t i) { return input.ids ? (*input.ids)[i] : i; };
+    auto key = [&](size_t id) -> const CellData& { return (*input.table.rows)[id].cells.elements[column].value; };
+    bool sorted = true;
+    for (size_t i = 1; sorted && i < input.size(); i++) sorted = !(key(row(i)) < key(row(i - 1)));
+    if (sorted) return {};
+    std::vector<size_t> order(input.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = row(i);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return key(a) < key(b); });
+    return order;
+}
+
+RowSet MergeJoinNode::produce(bool analyze) {
+    RowSet left = children[0]->execute(analyze);
+    RowSet right = children[1]->execute(analyze);
+    size_t left_at = key_position(left.table, left_key), right_at = key_position(right.table, right_key);
+    // a prepared plan can outlive the order it was chosen for
+    auto left_order = key_order(left, left_at), right_order = key_order(right, right_at);
+    auto left_id = [&](size_t i) { return !left_order.empty() ? left_order[i] : left.ids ? (*left.ids)[i] : i; };
+    auto right_id = [&](size_t j) { return !right_order.empty() ? right_order[j] : right.ids ? (*right.ids)[j] : j; };
+    auto left_key_at = [&](size_t i) -> const CellData& {
+        return (*left.table.rows)[left_id(i)].cells.elements[left_at].value;
+    };
+    auto right_key_at = [&](size_t j) -> const CellData& {
+        return (*right.table.rows)[right_id(j)].cells.elements[right_at].value;
+    };
+
+    JoinBuilder joined(left.table, right.table);
+    size_t i = 0, j = 0, n = left.size(), m = right.size();
+    while (i < n && j < m) {
+        auto order = left_key_at(i) <=> right_key_at(j);
+        if (order < 0) i++;
+        else if (order > 0) j++;
+        else if (order != 0) i++;  // unordered (NaN) matches nothing
+        else {
+            // every left row of a run of equal keys pairs with every right row of it
+            size_t left_end = i + 1, right_end = j + 1;
+            while (left_end < n && left_key_at(left_end) == left_key_at(i)) left_end++;
+            while (right_end < m && right_key_at(right_end) == left_key_at(i)) right_end++;
+            for (size_t a = i; a < left_end; a++) {
+                for (size_t b = j; b < right_end; b++) joined.add(left_id(a), right_id(b));
+            }
+            i = left_end;
+            j = right_end;
+        }
+    }
+    return {std::move(joined.result), std::nullopt};
+}
+
+SemiJoinNode::SemiJoinNode(PlanPtr input, PlanPtr subquery, ExprPtr key, bool anti) : key(key), anti(anti) {
+    children = {input, subquery};
+    estimated_rows = key.get() ? input->estimated_rows * 0.5 : input->estimated_rows;
+}
+
+std::string SemiJoinNode::describe() {
+    if (key.get() == nullptr) return anti ? "NotExists" : "Exists";
+    return (anti ? "HashAntiJoin " : "HashSemiJoin ") + key->str();
+}
+
+RowSet SemiJoinNode::produce(bool analyze) {
+    Table values = children[1]->execute(analyze).materialize();
+    RowSet input = children[0]->execute(analyze);
+    if (key.get() == nullptr) {
+        if (values.rows->empty() == anti) return input;
+        return {input.table, std::vector<size_t>()};
+    }
+    if (values.schema.size() != 1) throw std::runtime_error("IN (SELECT ...) must select one column");
+    std::vector<CellData> list;
+    for (auto& row : *values.rows) list.push_back(row.cells.elements[0].value);
+    ValueSet set(list);
+
+    std::vector<size_t> kept;
+    auto probe = [&](size_t id) {
+        if (set.contains(key->eval((*input.table.rows)[id])) != anti) kept.push_back(id);
+    };
+    if (input.ids) {
+        for (auto id : *input.ids) probe(id);
+    } else {
+        for (size_t id = 0; id < input.table.rows->size(); id++) probe(id);
+    }
+    if (current_stats) current_stats->rows_scanned += input.size();
+    return {input.table, kept};
+}
+
+ProjectNode::ProjectNode(PlanPtr input, std::vector<std::string> columns) : columns(columns) {
+    children.push_back(input);
+    estimated_rows = input->estimated_rows;
+}
+
+std::string ProjectNode::describe() {
+    std::string text = "Project";
+    if (columns.empty()) return text + " *";
+    for (size_t i = 0; i < columns.size(); i++) text += (i ? ", " : " ") + columns[i];
+    return text;
+}
+
+RowSet ProjectNode::produce(bool analyze) {
+    return {children[0]->execute(analyze).materialize(columns), std::nullopt};
+}
+
+DistinctNode::DistinctNode(PlanPtr input) {
+    children.push_back(input);
+    estimated_rows = input->estimated_rows;
+}
+
+std::string DistinctNode::describe() {
+    return "Distinct";
+}
+
+RowSet DistinctNode::produce(bool analyze) {
+    Table input = children[0]->execute(analyze).materialize();
+    auto cells = [&](size_t id) -> auto& { return (*input.rows)[id].cells.elements; };
+    auto hash = [&](size_t id) {
+        size_t h = 0;
+        for (auto& cell : cells(id)) h = h * 31 + cell.value.hash();
+        return h;
+    };
+    auto equal = [&](size_t a, size_t b) {
+        auto &x = cells(a), &y = cells(b);
+        for (size_t i = 0; i < x.size(); i++) {
+            if (!CellDataEqual()(x[i].value, y[i].value)) return false;
+        }
+        return true;
+    };
+    std::unordered_set<size_t, decltype(hash), decltype(equal)> seen(input.rows->size(), hash, equal);
+    std::vector<size_t> ids;
+    for (size_t id = 0; id < input.rows->size(); id++) {
+        if (seen.insert(id).second) ids.push_back(id);
+    }
+    if (ids.size() == input.rows->size()) return {input, std::nullopt};
+    return {RowSet{input, ids}.materialize(), std::nullopt};
+}
+
+UpdateNode::UpdateNode(PlanPtr input, Table& table, NamedVector<ExprPtr> assignments)
+    : table(table), assignments(assignments) {
+    children.push_back(input);
+    estimated_rows = input->estimated_rows;
+}
+
+std::string UpdateNode::describe() {
+    std::string text = "Update " + table.name + " set";
+    for (size_t i = 0; i < assignments.elements.size(); i++) {
+        auto& assignment = assignments.elements[i];
+        text += (i ? ", " : " ") + assignment.name + " = " + assignment.value->str();
+    }
+    return text;
+}
+
+RowSet UpdateNode::produce(bool analyze) {
+    // the input's copy of the table is dropped first so the update doesn't have to detach from it
+    auto ids = selected_rows(children[0]->execute(analyze));
+    table.update_rows(ids, assignments);
+    return {Table(), ids};
+}
+
+DeleteNode::DeleteNode(PlanPtr input, Table& table) : table(table) {
+    children.push_back(input);
+    estimated_rows = input->estimated_rows;
+}
+
+std::string DeleteNode::describe() {
+    return "Delete from " + table.name;
+}
+
+RowSet DeleteNode::produce(bool analyze) {
+    auto ids = selected_rows(children[0]->execute(analyze));
+    table.delete_rows(ids);
+    return {Table(), ids};
+}
+
+// Type of a `table.column` name when it names one of the table's columns.
+static std::optional<DataType> qualified_column(Table& table, const std::string& name) {
+    std::string prefix = table.name + ".";
+    if (name.compare(0, prefix.size(), prefix) != 0) return std::nullopt;
+    for (auto& column : table.schema.elements) {
+        if (column.name == name.substr(prefix.size())) return column.value;
+    }
+    return std::nullopt;
+}
+
+JoinPlanner::JoinPlanner(std::vector<Table*> tables, ExprPtr condition) : tables(tables) {
+    if (tables.size() > 64) throw std::runtime_error("Too many tables in one SELECT");
+    stats = [this](const std::string& name) -> const ColumnStats* {
+        auto i = table_of(name);
+        return i ? this->tables[*i]->column_stats(name.substr(this->tables[*i]->name.size() + 1)) : nullptr;
+    };
+    std::vector<std::vector<ExprPtr>> own(tables.size());
+    // ExprPtr overloads !, so test the pointer itself
+    auto all = condition.get() ? conjuncts(condition) : std::vector<ExprPtr>();
+    for (auto& expr : all) {
+        Term term{expr};
+        bool resolved = true;
+        for (auto& name : column_names(expr)) {
+            auto i = table_of(name);
+            if (i) term.tables |= uint64_t(1) << *i;
+            else resolved = false;
+        }
+        if (!resolved || term.tables == 0) {
+            rest.push_back(expr);
+        } else if (std::popcount(term.tables) == 1) {
+            size_t i = std::countr_zero(term.tables);
+            size_t prefix = tables[i]->name.size() + 1;
+            own[i].push_back(rename_columns(expr, [&](const std::string& name) { return name.substr(prefix); }));
+        } else {
+            terms.push_back(term);
+        }
+    }
+    for (size_t i = 0; i < tables.size(); i++) {
+        scans.push_back(make_temp<ScanNode>(*tables[i], conjunction(own[i])));
+    }
+    for (auto& term : terms) {
+        if (auto columns = column_equality(term.expr)) {
+            // each value of the side with more distinct values meets one of the
+            // other's; without statistics every row is taken to be distinct
+            double distinct = 1;
+            for (auto& name : {columns->first, columns->second}) {
+                auto column = stats(name);
+                distinct = std::max(distinct, column ? column->distinct_values() : double(tables[*table_of(name)]->rows->size()));
+            }
+            term.selectivity = 1 / distinct;
+        } else {
+            term.selectivity = estimate_selectivity(term.expr, stats);
+        }
+    }
+}
+
+std::optional<size_t> JoinPlanner::table_of(const std::string& column) {
+    for (size_t i = 0; i < tables.size(); i++) {
+        if (qualified_column(*tables[i], column)) return i;
+    }
+    return std::nullopt;
+}
+
+double JoinPlanner::estimate_rows(uint64_t set) {
+    double rows = 1;
+    for (size_t i = 0; i < tables.size(); i++) {
+        if (set & (uint64_t(1) << i)) rows *= scans[i]->estimated_rows;
+    }
+    for (auto& term : terms) {
+        if ((term.tables & ~set) == 0) rows *= term.selectivity;
+    }
+    return rows;
+}
+
+std::vector<size_t> JoinPlanner::order() {
+    size_t n = tables.size();
+    if (n <= MAX_EXHAUSTIVE_TABLES) {
+        // best left-deep order of every subset, from the best orders of its subsets
+        std::vector<double> cost(size_t(1) << n, INFINITY);
+        std::vector<std::vector<size_t>> best(size_t(1) << n);
+        for (size_t i = 0; i < n; i++) {
+            cost[size_t(1) << i] = 0;
+            best[size_t(1) << i] = {i};
+        }
+        for (size_t set = 1; set < cost.size(); set++) {
+            if (std::popcount(set) < 2) continue;
+            double rows = estimate_rows(set);
+            // the last table added is tried from the back, so ties keep the written order
+            for (size_t i = n; i-- > 0;) {
+                size_t before = set & ~(size_t(1) << i);
+                if (before == set || cost[before] + rows >= cost[set]) continue;
+                cost[set] = cost[before] + rows;
+                best[set] = best[before];
+                best[set].push_back(i);
+            }
+        }
+        return best.back();
+    }
+    // greedy: start from the smallest table, then add whichever keeps the result smallest
+    std::vector<size_t> result;
+    uint64_t set = 0;
+    while (result.size() < n) {
+        size_t next = n;
+        double rows = INFINITY;
+        for (size_t i = 0; i < n; i++) {
+            if (set & (uint64_t(1) << i)) continue;
+            double joined = estimate_rows(set | (uint64_t(1) << i));
+            if (joined < rows) {
+                rows = joined;
+                next = i;
+            }
+        }
+        result.push_back(next);
+        set |= uint64_t(1) << next;
+    }
+    return result;
+}
+
+// Scans come out in table order, so two scans of tables sorted on the keys are
+// merged in place; joins' output order isn't tracked. Any other merge join sorts
+// the positions of its unsorted inputs, which only pays when the hash table it
+// replaces would be both larger and over the memory budget.
+bool JoinPlanner::merge_join(PlanPtr left, size_t right, const std::pair<std::string, std::string>& keys) {
+    auto sorted = [](Table& table, const std::string& key) {
+        return table.sorted_on(table.column_index(key.substr(table.name.size() + 1)));
+    };
+    auto scan = std::dynamic_pointer_cast<ScanNode>(left);
+    bool left_sorted = scan && sorted(scan->table, keys.first);
+    bool right_sorted = sorted(*tables[right], keys.second);
+    if (left_sorted && right_sorted) return true;
+    double hash_bytes = std::min(left->estimated_rows, scans[right]->estimated_rows) * HASH_BYTES_PER_ROW;
+    double sort_bytes = ((left_sorted ? 0 : left->estimated_rows) +
+                         (right_sorted ? 0 : scans[right]->estimated_rows)) * SORT_BYTES_PER_ROW;
+    return hash_bytes > double(memory_budget) && sort_bytes < hash_bytes;
+}
+
+PlanPtr JoinPlanner::build(const std::vector<size_t>& order) {
+    PlanPtr result = scans[order[0]];
+    uint64_t joined = uint64_t(1) << order[0];
+    for (size_t k = 1; k < order.size(); k++) {
+        size_t i = order[k];
+        uint64_t table = uint64_t(1) << i;
+        std::optional<std::pair<std::string, std::string>> keys;
+        std::vector<ExprPtr> now;
+        for (auto& term : terms) {
+            if (!(term.tables & table) || (term.tables & ~(joined | table))) continue;
+            auto columns = column_equality(term.expr);
+            if (!keys && columns) {
+                auto [left_key, right_key] = *columns;
+                if (table_of(left_key) == i) std::swap(left_key, right_key);
+                auto left_type = qualified_column(*tables[*table_of(left_key)], left_key);
+                auto right_type = qualified_column(*tables[i], right_key);
+                // text against numbers compares as strings, which hashing can't follow
+                if (table_of(left_key) != i && right_type &&
+                    (*left_type == DataType::TEXT) == (*right_type == DataType::TEXT)) {
+                    keys = {left_key, right_key};
+                    continue;
+                }
+            }
+            now.push_back(term.expr);
+        }
+        if (keys && merge_join(result, i, *keys)) {
+            result = make_temp<MergeJoinNode>(result, scans[i], keys->first, keys->second, stats);
+        } else if (keys) {
+            result = make_temp<HashJoinNode>(result, scans[i], keys->first, keys->second, stats);
+        } else {
+            result = make_temp<NestedLoopJoinNode>(result, scans[i]);
+        }
+        if (!now.empty()) result = make_temp<FilterNode>(result, conjunction(now), stats);
+        joined |= table;
+    }
+    if (!rest.empty()) result = make_temp<FilterNode>(result, conjunction(rest), stats);
+    return result;
+}
+
+static void explain_lines(PlanPtr node, int depth, std::vector<std::string>& lines) {
+    std::ostringstream line;
+    line << std::string(depth * 2, ' ') << node->describe();
+    if (node->analyzed) {
+        line.precision(3);
+        line << std::fixed << " (rows=" << node->actual_rows << " time=" << node->actual_ms << "ms";
+        if (ALLOCATIONS_COUNTED) line << " memory=" << node->actual_bytes << "B";
+        line << ")";
+    }
+    lines.push_back(line.str());
+    for (auto& child : node->children) explain_lines(child, depth + 1, lines);
+}
+
+Table explain_table(PlanPtr root) {
+    Schema schema;
+    schema["plan"] = DataType::TEXT;
+    std::vector<std::string> lines;
+    explain_lines(root, 0, lines);
+    std::vector<Row> rows;
+    for (auto& line : lines) {
+        Row row(schema);
+        row.cells.elements[0].value = CellData(line);
+        rows.push_back(std::move(row));
+    }
+    Table result("explain", schema);
+    result.append_rows(std::move(rows));
+    return result;
+}
@@ -0,0 +1,204 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include "table.hpp"
+#include "bloom.hpp"
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Rows passed between plan operators: positions into a table, so filters only
+// narrow the list and the projection copies just the cells that survive.
+struct RowSet {
+    Table table;
+    std::optional<std::vector<size_t>> ids;  // every row of `table` when nullopt
+
+    size_t size() const { return ids ? ids->size() : table.rows->size(); }
+    Table materialize(std::vector<std::string> cols = {});  // keeps the table's name
+};
+
+// One operator of a statement's execution tree. execute() runs it (children
+// first, from produce()) and under EXPLAIN ANALYZE records what it did.
+class PlanNode {
+public:
+    std::vector<std::shared_ptr<PlanNode>> children;
+    double estimated_rows = 0;  // the planner's guess, from ANALYZE statistics where there are any
+
+    // filled in by EXPLAIN ANALYZE; time and memory include the children
+    bool analyzed = false;
+    size_t actual_rows = 0;
+    double actual_ms = 0;
+    uint64_t actual_bytes = 0;
+
+    virtual ~PlanNode() = default;
+    virtual std::string describe() = 0;  // the operator's EXPLAIN line, without actuals
+    virtual RowSet produce(bool analyze) = 0;
+    RowSet execute(bool analyze = false);
+};
+
+using PlanPtr = std::shared_ptr<PlanNode>;
+
+// Rows of a stored table satisfying `condition` (all of them without one),
+// reached through the access path the table offers for it. With statistics the
+// condition's AND-ed terms are reordered to test the most selective first.
+class ScanNode : public PlanNode {
+public:
+    Table& table;
+    ExprPtr condition;
+    AccessPath path;
+    // Set by a hash join over this scan: while the join runs, rows whose value in
+    // this column is not among its build side's keys are dropped here.
+    std::string filter_column;  // empty when no join filters the scan
+    std::shared_ptr<BloomFilter> runtime_filter;
+    // The path holds index candidates and parameter values, so a plan run again
+    // (by a prepared statement) finds it anew for each later execution.
+    bool path_fresh = true;
+
+    ScanNode(Table& table, ExprPtr condition);
+    std::string describe() override;
+    RowSet produce(bool analyze) override;
+};
+
+class FilterNode : public PlanNode {
+public:
+    ExprPtr condition;
+
+    FilterNode(PlanPtr input, ExprPtr condition, const ColumnStatsLookup& stats);
+    std::string describe() override;
+    RowSet produce(bool analyze) override;
+};
+
+// Every pairing of the two inputs' rows, with columns prefixed by table name.
+class NestedLoopJoinNode : public PlanNode {
+public:
+    NestedLoopJoinNode(PlanPtr left, PlanPtr right);
+    std::string describe() override;
+    RowSet produce(bool analyze) override;
+};
+
+// Equi-join: hashes the input expected to be smaller on its key column and probes
+// it with the other's rows. Output is in the same order a nested loop gives.
+class HashJoinNode : public PlanNode {
+public:
+    // build sides smaller than this share of the probe key's distinct values filter the probe scan
+    static constexpr double BLOOM_MAX_KEY_FRACTION = 0.5;
+
+    std::string left_key, right_key;  // column names as the join condition has them
+    bool build_left;
+    std::shared_ptr<ScanNode> probe_scan;  // the other input, when it is a scan given a bloom filter
+
+    HashJoinNode(PlanPtr left, PlanPtr right, std::string left_key, std::string right_key,
+                 const ColumnStatsLookup& stats);
+    std::string describe() override;
+    RowSet produce(bool analyze) override;
+};
+
+// Equi-join by walking both inputs in key order, adding each run of equal keys
+// to the output as it is found. Inputs already in key order are read in place,
+// so beyond its output the join needs no memory; others get a sorted list of
+// positions first, and the output then comes in key order.
+class MergeJoinNode : public PlanNode {
+public:
+    std::string left_key, right_key;
+
+    MergeJoinNode(PlanPtr left, PlanPtr right, std::string left_key, std::string right_key,
+                  const ColumnStatsLookup& stats);
+    std::string describe() override;
+    RowSet produce(bool analyze) override;
+};
+
+// Rows of the first input kept by the uncorrelated subquery that is the second,
+// which runs once beforehand. For IN its values become a hash set probed with
+// each row's key; for EXISTS it only has to return a row. Anti-joins keep the
+// rows a semi-join would drop.
+class SemiJoinNode : public PlanNode {
+public:
+    ExprPtr key;  // null for EXISTS
+    bool anti;
+
+    SemiJoinNode(PlanPtr input, PlanPtr subquery, ExprPtr key, bool anti);
+    std::string describe() override;
+    RowSet produce(bool analyze) override;
+};
+
+class ProjectNode : public PlanNode {
+public:
+    std::vector<std::string> columns;  // empty for *
+
+    ProjectNode(PlanPtr input, std::vector<std::string> columns);
+    std::string describe() override;
+    RowSet produce(bool analyze) override;
+};
+
+// The input's rows with repeats dropped, first occurrences kept in order.
+class DistinctNode : public PlanNode {
+public:
+    DistinctNode(PlanPtr input);
+    std::string describe() override;
+    RowSet produce(bool analyze) override;
+};
+
+// Changes the stored table's rows its input selects; produces their positions.
+class UpdateNode : public PlanNode {
+public:
+    Table& table;
+    NamedVector<ExprPtr> assignments;
+
+    UpdateNode(PlanPtr input, Table& table, NamedVector<ExprPtr> assignments);
+    std::string describe() override;
+    RowSet produce(bool analyze) override;
+};
+
+class DeleteNode : public PlanNode {
+public:
+    Table& table;
+
+    DeleteNode(PlanPtr input, Table& table);
+    std::string describe() override;
+    RowSet produce(bool analyze) override;
+};
+
+// Plans the joins of a SELECT over several tables. Terms of the condition that
+// read a single table filter its scan; the others are applied at the first join
+// that has all of their tables, where an equality between the newly joined table
+// and the ones before it makes a hash or merge join.
+class JoinPlanner {
+public:
+    static constexpr size_t MAX_EXHAUSTIVE_TABLES = 10;  // more tables are ordered greedily
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t(64) << 20;
+    static constexpr double HASH_BYTES_PER_ROW = 128;  // key copy, node, bucket and position list
+    static constexpr double SORT_BYTES_PER_ROW = sizeof(size_t);  // a merge join's sorted positions
+
+    struct Term {
+        ExprPtr expr;
+        uint64_t tables = 0;  // bit i for each of tables[i] the term reads
+        double selectivity = 1;
+    };
+
+    std::vector<Table*> tables;  // in the order the query names them
+    std::vector<std::shared_ptr<ScanNode>> scans;  // one per table, with its own terms
+    std::vector<Term> terms;     // the terms reading two tables or more
+    std::vector<ExprPtr> rest;   // terms reading no table, or a column none has: filtered last
+    ColumnStatsLookup stats;     // by `table.column` name
+    // Joins whose inputs are scans already in key order are merge joins; so is a
+    // hash join expected to need more than this, if sorting its inputs takes less.
+    size_t memory_budget = DEFAULT_MEMORY_BUDGET;
+
+    JoinPlanner(std::vector<Table*> tables, ExprPtr condition);
+    JoinPlanner(const JoinPlanner&) = delete;  // `stats` refers back to the planner
+
+    std::optional<size_t> table_of(const std::string& column);
+    double estimate_rows(uint64_t set);  // rows left after joining the set's tables
+    // Table positions in join order: the order with the smallest sum of intermediate
+    // results, preferring the order written among equals.
+    std::vector<size_t> order();
+    bool merge_join(PlanPtr left, size_t right, const std::pair<std::string, std::string>& keys);
+    PlanPtr build(const std::vector<size_t>& order);
+};
+
+// EXPLAIN output: a `plan` column with one row per operator, children indented
+// under their parent and, once analyzed, the actual rows, time and memory.
+Table explain_table(PlanPtr root);
+
+#endif
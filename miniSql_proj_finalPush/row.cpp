@@ -1,15 +1,19 @@
 #include "row.hpp"
 
 Row::Row(Schema schema) : schema(schema) {
-    for(size_t i = 0; i < schema.elements.size(); i++) {
-        cells[schema.elements[i].name] = CellData(schema[i]);
+    cells.elements.reserve(schema.elements.size());
+    for(auto& column : schema.elements) {
+        cells.elements.emplace_back(column.name, CellData(column.value));
     }
 }
 
-CellData Row::operator[](std::string name) {
-    return cells[name];
+CellData Row::operator[](std::string name) const {
+    for(auto& cell : cells.elements) {
+        if(cell.name == name) return cell.value;
+    }
+    return CellData();
 }
 
-CellData Row::operator[](size_t index) {
+CellData Row::operator[](size_t index) const {
     return cells[index];
 }
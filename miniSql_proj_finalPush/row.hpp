@@ -10,7 +10,7 @@ public:
     NamedVector<CellData> cells;
     
     Row(Schema schema);
-    CellData operator[](std::string name);
-    CellData operator[](size_t index);
+    CellData operator[](std::string name) const;  // a default cell when the row has no such column
+    CellData operator[](size_t index) const;
 };
 #endif
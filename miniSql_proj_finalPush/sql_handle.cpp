@@ -1,220 +1,315 @@
+#include <algorithm>
 #include <string>
 #include <memory>
 #include <vector>
 #include <sstream>
-#include <regex>
 #include <unordered_set>
+#include <fstream>
 #include "expr.hpp"
 #include "sql_handle.hpp"
+#include "csv_manip.hpp"
 
 
 
 
-const std::unordered_set<std::string> KEYWORDS = {
+const std::unordered_set<std::string_view> KEYWORDS = {
     "CREATE", "DROP", "USE", "DATABASE", "TABLE",
     "INSERT", "INTO", "VALUES", "DELETE", "FROM",
     "UPDATE", "SET", "SELECT", "WHERE", "INTEGER",
-    "FLOAT", "TEXT"
+    "FLOAT", "TEXT", "BIGINT", "DECIMAL", "AND", "OR", "NOT", "BITMAP", "INDEX",
+    "COPY", "SHOW", "EXPLAIN", "ANALYZE", "IN", "EXISTS"
 };
 
-std::string cleanse(std::string input) {
-    std::stringstream ss;
-    bool in_quote = false;
-    
-    for (size_t i = 0; i < input.length(); i++) {
+std::string token::Token::str() const {
+    std::string value(text);
+    if (quoted) {
+        // '' inside a quoted literal stands for a single quote
+        size_t out = 0;
+        for (size_t i = 0; i < value.size(); i++, out++) {
+            value[out] = value[i];
+            if (value[i] == '\'' && i + 1 < value.size() && value[i + 1] == '\'') i++;
+        }
+        value.resize(out);
+    }
+    return value;
+}
+
+static bool is_word_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+}
+
+// Single pass over the script; every token is a view into `input`, and the list
+// itself is allocated from `memory`.
+token::TokenList tokenize(std::string_view input, std::pmr::memory_resource* memory) {
+    using token::Type;
+    token::TokenList tokens(memory);
+    size_t i = 0, n = input.size();
+
+    while (i < n) {
         char c = input[i];
-        
-        if (c == '\'') {
-            in_quote = !in_quote;
-            ss << c;
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
             continue;
         }
-        
-        if (in_quote) {
-            if (c == ' ' || c == '\n') ss << '_';
-            else ss << c;
+        if (c == '-' && i + 1 < n && input[i + 1] == '-') {
+            while (i < n && input[i] != '\n') i++;
             continue;
         }
-        
-        if (c == '\n') {
-            ss << ' ';
-        } else if (std::string("()+-*/,;=<>").find(c) != std::string::npos) {
-            ss << ' ' << c << ' ';
-        } else {
-            ss << c;
+
+        size_t start = i;
+        if (c == '\'') {
+            i++;
+            while (true) {
+                if (i >= n) throw std::runtime_error("Unterminated string literal");
+                if (input[i] == '\'') {
+                    if (i + 1 < n && input[i + 1] == '\'') {
+                        i += 2;
+                        continue;
+                    }
+                    break;
+                }
+                i++;
+            }
+            tokens.push_back({Type::Literal, input.substr(start + 1, i - start - 1), true});
+            i++;
+            continue;
         }
-    }
-    
-    return ss.str();
-}
-token::TokenList tokenize(const std::string& input) {
-    token::TokenList tokens;
-    std::istringstream iss(input);
-    std::string token;
-    
-    while (iss >> token) {
-        if (KEYWORDS.find(token) != KEYWORDS.end()) {
-            tokens.push_back(std::make_shared<token::Keyword>(token));
+        if (c == '?') {
+            tokens.push_back({Type::Parameter, input.substr(i, 1)});
+            i++;
             continue;
         }
-        
-        if (token[0] == '\'') {
-            std::string literal = token.substr(1, token.length()-2);
-            literal = std::regex_replace(literal, std::regex("_"), " ");
-            tokens.push_back(std::make_shared<token::Literal>(literal));
+        if (c == '(' || c == ')' || c == ',' || c == ';') {
+            tokens.push_back({Type::Punctuation, input.substr(i, 1)});
+            i++;
             continue;
         }
-        
-        if (std::string("(),;").find(token[0]) != std::string::npos) {
-            tokens.push_back(std::make_shared<token::Punctuation>(token[0]));
+        if (c == '<' || c == '>' || c == '!') {
+            using token::Op;
+            i++;
+            char next = i < n ? input[i] : '\0';
+            Op op = c == '<' ? Op::Less : c == '>' ? Op::Greater : Op::None;
+            if (next == '=') op = c == '<' ? Op::LessEqual : c == '>' ? Op::GreaterEqual : Op::NotEqual;
+            else if (c == '<' && next == '>') op = Op::NotEqual;
+            if (op != Op::Less && op != Op::Greater) i++;
+            if (op == Op::None) throw std::runtime_error("Unexpected character '!'");
+            tokens.push_back({Type::Operator, input.substr(start, i - start), false, op});
             continue;
         }
-        
-        if (std::string("=<>+-*/").find(token[0]) != std::string::npos) {
-            tokens.push_back(std::make_shared<token::Operator>(token));
+        if (c == '=' || c == '+' || c == '-' || c == '*' || c == '/') {
+            using token::Op;
+            Op op = c == '=' ? Op::Equal : c == '+' ? Op::Plus : c == '-' ? Op::Minus :
+                    c == '*' ? Op::Multiply : Op::Divide;
+            tokens.push_back({Type::Operator, input.substr(i, 1), false, op});
+            i++;
             continue;
         }
-        
-        if (std::isdigit(token[0]) || token[0] == '-' || token[0] == '.') {
-            tokens.push_back(std::make_shared<token::Literal>(token));
+        if (std::isdigit(static_cast<unsigned char>(c)) ||
+            (c == '.' && i + 1 < n && std::isdigit(static_cast<unsigned char>(input[i + 1])))) {
+            while (i < n && (std::isalnum(static_cast<unsigned char>(input[i])) || input[i] == '.')) i++;
+            tokens.push_back({Type::Literal, input.substr(start, i - start)});
             continue;
         }
-        
-        tokens.push_back(std::make_shared<token::Identifier>(token));
+        if (is_word_char(c)) {
+            while (i < n && is_word_char(input[i])) i++;
+            auto word = input.substr(start, i - start);
+            if (!KEYWORDS.count(word)) {
+                tokens.push_back({Type::Identifier, word});
+                continue;
+            }
+            using token::Op;
+            Op op = word == "AND" ? Op::And : word == "OR" ? Op::Or : word == "NOT" ? Op::Not :
+                    word == "IN" ? Op::In : word == "EXISTS" ? Op::Exists : Op::None;
+            tokens.push_back({Type::Keyword, word, false, op});
+            continue;
+        }
+        throw std::runtime_error("Unexpected character '" + std::string(1, c) + "'");
     }
     return tokens;
 }
 
+// Quoted literals are always text; bare ones are typed by their spelling.
+CellData literal_cell(token::Token token) {
+    if (token.quoted) return CellData(token.str());
+    return inferred_cell(token.str());
+}
+
+
+// Binding powers, loosest first. NOT binds looser than comparisons and unary
+// minus tighter than everything, so `NOT a = -b * c OR d` is `(NOT (a = ((-b) * c))) OR d`.
+static constexpr int NOT_PRECEDENCE = 3;
+static constexpr int COMPARISON_PRECEDENCE = 4;  // also of [NOT] IN (...)
+static constexpr int NEGATE_PRECEDENCE = 7;
 
-ExprPtr SqlInterpreter::read_expr() {
-    auto start = cursor;
-    int paren_cnt = 0;
+static int binary_precedence(token::Op op) {
+    using token::Op;
+    switch (op) {
+        case Op::Or: return 1;
+        case Op::And: return 2;
+        case Op::Equal: case Op::NotEqual:
+        case Op::Less: case Op::LessEqual:
+        case Op::Greater: case Op::GreaterEqual: return COMPARISON_PRECEDENCE;
+        case Op::Plus: case Op::Minus: return 5;
+        case Op::Multiply: case Op::Divide: return 6;
+        default: return 0;  // not a binary operator: the expression ends here
+    }
+}
 
+static ExprPtr make_binary(token::Op op, ExprPtr left, ExprPtr right) {
+    using token::Op;
+    switch (op) {
+        case Op::Or: return left || right;
+        case Op::And: return left && right;
+        case Op::Equal: return left == right;
+        case Op::NotEqual: return left != right;
+        case Op::Less: return left < right;
+        case Op::LessEqual: return left <= right;
+        case Op::Greater: return left > right;
+        case Op::GreaterEqual: return left >= right;
+        case Op::Plus: return left + right;
+        case Op::Minus: return left - right;
+        case Op::Multiply: return left * right;
+        case Op::Divide: return left / right;
+        default: throw std::runtime_error("Unknown operator");
+    }
+}
+
+// Precedence climbing: one pass over the tokens, stopping at the first token that
+// is not a binary operator (`,` `;` `)` or a clause keyword such as WHERE).
+ExprPtr SqlInterpreter::read_expr(int min_precedence) {
+    ExprPtr left = read_operand();
     while (cursor != tokens.end()) {
-        auto& token = *cursor;
-        
-        if (typeid(*token) == typeid(token::Punctuation)) {
-            auto p = std::dynamic_pointer_cast<token::Punctuation>(token)->str();
-            if (p == "(") {
-                paren_cnt++;
-            } else if (p == ")") {
-                paren_cnt--;
-                if (paren_cnt < 0) break;
-            } else if (p == ";" || p == ",") {
-                break;
-            }
-        } else if (paren_cnt == 0 &&
-                  !(typeid(*token) == typeid(token::Identifier) ||
-                    typeid(*token) == typeid(token::Literal) ||
-                    typeid(*token) == typeid(token::Operator))) {
-            break;
+        if (min_precedence <= COMPARISON_PRECEDENCE && at_in_list()) {
+            left = read_in_list(left);
+            continue;
         }
+        token::Op op = cursor->op;
+        int precedence = binary_precedence(op);
+        if (precedence == 0 || precedence < min_precedence) break;
         cursor++;
+        // operators are left associative: the right side only takes tighter ones
+        left = make_binary(op, left, read_expr(precedence + 1));
     }
-    
-    return parse_expr_range(start, cursor);
+    return left;
 }
 
-ExprPtr SqlInterpreter::read_condition() {
-    ExprPtr condition = read_expr();
-    
-    if (cursor != tokens.end() && typeid(*peek()) == typeid(token::Keyword)) {
-        auto op = std::dynamic_pointer_cast<token::Keyword>(peek())->str();
-        if (op == "AND" || op == "OR") {
-            cursor++;
-            ExprPtr right = read_expr();
-            return op == "AND" ? condition && right : condition || right;
+ExprPtr SqlInterpreter::read_operand() {
+    auto& token = peek();
+    if (token.op == token::Op::Minus) {
+        cursor++;
+        return -read_expr(NEGATE_PRECEDENCE);
+    }
+    if (token.op == token::Op::Not) {
+        cursor++;
+        ExprPtr operand = read_expr(NOT_PRECEDENCE);
+        if (auto subquery = dynamic_cast<Subquery*>(operand.get())) {
+            subquery->negated = !subquery->negated;
+            return operand;
         }
+        return !operand;
     }
-    
-    return condition;
+    if (token.op == token::Op::Exists) {
+        cursor++;
+        return make_temp<Subquery>(nullptr, read_subquery());
+    }
+    if (token.type == token::Type::Punctuation && token.text == "(") {
+        cursor++;
+        ExprPtr inner = read_expr();
+        expect(")", "Expected ) in expression");
+        return inner;
+    }
+    if (token.type == token::Type::Identifier) {
+        cursor++;
+        return col(token.str());
+    }
+    if (token.type == token::Type::Literal) {
+        cursor++;
+        return literal(literal_cell(token), token.quoted ? std::nullopt : exact_literal(token.str()));
+    }
+    if (token.type == token::Type::Parameter) {
+        return read_param();
+    }
+    throw std::runtime_error("Invalid expression term");
 }
 
-ExprPtr SqlInterpreter::parse_expr_range(token::TokenList::iterator start, token::TokenList::iterator end) {
-    // Find top-level operator
-    auto op_pos = end;
-    int paren_cnt = 0;
-    int min_priority = 999;
-    
-    for (auto it = start; it != end; ++it) {
-        const token::TokenPtr& token = *it;
-        
-        if (typeid(*token) == typeid(token::Punctuation)) {
-            auto p = std::dynamic_pointer_cast<token::Punctuation>(token)->str();
-            if (p == "(") paren_cnt++;
-            else if (p == ")") paren_cnt--;
-        }
-        else if (paren_cnt == 0 && typeid(*token) == typeid(token::Operator)) {
-            auto op = std::dynamic_pointer_cast<token::Operator>(token)->str();
-            int priority;
-            if (op == "+" || op == "-") priority = 1;
-            else if (op == "*" || op == "/") priority = 2;
-            else priority = 0;  // comparison ops
-            
-            if (priority <= min_priority) {
-                min_priority = priority;
-                op_pos = it;
-            }
-        }
+bool SqlInterpreter::at_in_list() {
+    if (cursor->op == token::Op::In) return true;
+    return cursor->op == token::Op::Not && cursor + 1 != tokens.end() && (cursor + 1)->op == token::Op::In;
+}
+
+// [NOT] IN (constant, ...) after `operand`; the list becomes a set probed once per row.
+ExprPtr SqlInterpreter::read_in_list(ExprPtr operand) {
+    bool negated = cursor->op == token::Op::Not;
+    if (negated) cursor++;
+    cursor++;
+    if (peek().text == "(" && cursor + 1 != tokens.end() && (cursor + 1)->text == "SELECT") {
+        auto subquery = make_temp<Subquery>(operand, read_subquery());
+        subquery->negated = negated;
+        return subquery;
     }
-    
-    // No operator found - must be a single term or parenthesized expr
-    if (op_pos == end) {
-        if (start == end) {
-            throw std::runtime_error("Empty expression");
-        }
-        
-        const token::TokenPtr& token = *start;
-        // Check if parenthesized
-        if (typeid(*token) == typeid(token::Punctuation) &&
-            std::dynamic_pointer_cast<token::Punctuation>(token)->str() == "(") {
-            return parse_expr_range(std::next(start), std::prev(end));
-        }
-        
-        // Must be literal/identifier
-        if (typeid(*token) == typeid(token::Identifier)) {
-            return col(std::dynamic_pointer_cast<token::Identifier>(token)->str());
-        }
-        if (typeid(*token) == typeid(token::Literal)) {
-            return literal(inferred_cell(std::dynamic_pointer_cast<token::Literal>(token)->str()));
-        }
-        throw std::runtime_error("Invalid expression term");
+    expect("(", "Expected ( after IN");
+    std::vector<CellData> values;
+    while (true) {
+        ExprPtr value = read_expr();
+        auto constant = dynamic_cast<Literal*>(value.get());
+        if (!constant) throw std::runtime_error("IN list values must be constants");
+        values.push_back(constant->value);
+        if (peek().text != ",") break;
+        cursor++;
     }
-    
-    // Build expression tree with found operator
-    auto op = std::dynamic_pointer_cast<token::Operator>(*op_pos)->str();
-    ExprPtr left = parse_expr_range(start, op_pos);
-    ExprPtr right = parse_expr_range(std::next(op_pos), end);
-    
-    if (op == "+") return left + right;
-    if (op == "-") return left - right;
-    if (op == "*") return left * right;
-    if (op == "/") return left / right;
-    if (op == "<") return left < right;
-    if (op == ">") return left > right;
-    if (op == "=") return left == right;
-    throw std::runtime_error("Unknown operator: " + op);
+    expect(")", "Expected ) after IN list");
+    ExprPtr in = make_temp<InList>(operand, values);
+    return negated ? !in : in;
+}
+
+// (SELECT ...) of IN or EXISTS
+std::shared_ptr<SelectStatement> SqlInterpreter::read_subquery() {
+    expect("(", "Expected ( before subquery");
+    expect("SELECT", "Expected SELECT in subquery");
+    auto query = make_temp<SelectStatement>(read_select(true));
+    expect(")", "Expected ) after subquery");
+    return query;
+}
+
+std::shared_ptr<Param> SqlInterpreter::read_param() {
+    read_token(token::Type::Parameter);
+    if (!params) throw std::runtime_error("? is only allowed in prepared statements");
+    params->push_back(std::nullopt);
+    return make_temp<Param>(params, params->size() - 1);
 }
 
 // sql_handle.cpp
-std::vector<CellData> SqlInterpreter::read_values() {
+std::vector<CellData> SqlInterpreter::read_values(size_t row, std::vector<InsertStatement::ParamSlot>& params) {
    std::vector<CellData> values;
    
-   if (typeid(*peek()) != typeid(token::Punctuation) ||
-       std::dynamic_pointer_cast<token::Punctuation>(peek())->str() != "(") {
+   if (peek().type != token::Type::Punctuation ||
+       peek().text != "(") {
        throw std::runtime_error("Expected ( after VALUES");
    }
    cursor++;
 
    while (true) {
-       if (typeid(*peek()) != typeid(token::Literal)) {
+       if (peek().type == token::Type::Parameter) {
+           params.push_back({row, values.size(), read_param()});
+           values.push_back(CellData());
+       } else if (peek().type == token::Type::Literal || peek().op == token::Op::Minus) {
+           // a number may carry a sign
+           bool negative = peek().op == token::Op::Minus;
+           if (negative) cursor++;
+           if (peek().type != token::Type::Literal || (negative && peek().quoted)) {
+               throw std::runtime_error("Expected literal in VALUES");
+           }
+           // numbers written with a point stay exact until run() knows the column's type
+           auto exact = peek().quoted ? std::nullopt : exact_literal(peek().str());
+           CellData value = exact ? *exact : literal_cell(peek());
+           values.push_back(negative ? arithmetic(ArithmeticOp::Subtract, CellData(0), value) : value);
+           cursor++;
+       } else {
            throw std::runtime_error("Expected literal in VALUES");
        }
-       values.push_back(inferred_cell(std::dynamic_pointer_cast<token::Literal>(peek())->str()));
-       cursor++;
 
-       if (typeid(*peek()) == typeid(token::Punctuation)) {
-           auto p = std::dynamic_pointer_cast<token::Punctuation>(peek())->str();
+       if (peek().type == token::Type::Punctuation) {
+           auto p = peek().text;
            if (p == ")") {
                cursor++;
                break;
@@ -230,33 +325,75 @@ std::vector<CellData> SqlInterpreter::read_values() {
    return values;
 }
 
-Schema SqlInterpreter::read_schema() {
-   if (typeid(*peek()) != typeid(token::Punctuation) ||
-       std::dynamic_pointer_cast<token::Punctuation>(peek())->str() != "(") {
+std::tuple<Schema, std::string, std::vector<DecimalSpec>> SqlInterpreter::read_schema() {
+   if (peek().type != token::Type::Punctuation ||
+       peek().text != "(") {
        throw std::runtime_error("Expected ( after CREATE TABLE");
    }
    cursor++;
    
    Schema schema;
+   std::string primary_key;
+   std::vector<DecimalSpec> decimals;
    while (true) {
-       if (typeid(*peek()) != typeid(token::Identifier)) {
-           throw std::runtime_error("Expected column name");
-       }
-       auto col_name = std::dynamic_pointer_cast<token::Identifier>(peek())->str();
-       cursor++;
-       
-       if (typeid(*peek()) != typeid(token::Keyword)) {
-           throw std::runtime_error("Expected type after column name");
+       if (peek().text == "PRIMARY") {
+           // table constraint: PRIMARY KEY (col)
+           cursor++;
+           expect("KEY", "Expected KEY after PRIMARY");
+           expect("(", "Expected ( after PRIMARY KEY");
+           if (!primary_key.empty()) throw std::runtime_error("Multiple primary keys");
+           primary_key = read_token(token::Type::Identifier).str();
+           expect(")", "Expected ) after PRIMARY KEY column");
+       } else {
+           if (peek().type != token::Type::Identifier) {
+               throw std::runtime_error("Expected column name");
+           }
+           auto col_name = peek().str();
+           cursor++;
+           
+           if (peek().type != token::Type::Keyword) {
+               throw std::runtime_error("Expected type after column name");
+           }
+           auto type_str = peek().str();
+           if (type_str == "INTEGER") schema[col_name] = DataType::INTEGER;
+           else if (type_str == "FLOAT") schema[col_name] = DataType::FLOAT;
+           else if (type_str == "TEXT") schema[col_name] = DataType::TEXT;
+           else if (type_str == "BIGINT") schema[col_name] = DataType::BIGINT;
+           else if (type_str == "DECIMAL") schema[col_name] = DataType::DECIMAL;
+           else throw std::runtime_error("Unknown type: " + type_str);
+           cursor++;
+
+           // DECIMAL(precision, scale), both optional
+           DecimalSpec spec;
+           if (type_str == "DECIMAL" && peek().text == "(") {
+               cursor++;
+               spec.precision = int(literal_cell(read_token(token::Type::Literal)));
+               spec.scale = 0;
+               if (peek().text == ",") {
+                   cursor++;
+                   spec.scale = int(literal_cell(read_token(token::Type::Literal)));
+               }
+               expect(")", "Expected ) after DECIMAL precision");
+               if (spec.precision < 1 || spec.precision > CellData::MAX_DECIMAL_DIGITS ||
+                   spec.scale < 0 || spec.scale > spec.precision) {
+                   throw std::runtime_error("Invalid DECIMAL(" + std::to_string(spec.precision) + "," +
+                                            std::to_string(spec.scale) + ")");
+               }
+           }
+           decimals.resize(schema.size());
+           decimals.back() = spec;
+
+           // column constraint: col TYPE PRIMARY KEY
+           if (peek().text == "PRIMARY") {
+               cursor++;
+               expect("KEY", "Expected KEY after PRIMARY");
+               if (!primary_key.empty()) throw std::runtime_error("Multiple primary keys");
+               primary_key = col_name;
+           }
        }
-       auto type_str = std::dynamic_pointer_cast<token::Keyword>(peek())->str();
-       if (type_str == "INTEGER") schema[col_name] = DataType::INTEGER;
-       else if (type_str == "FLOAT") schema[col_name] = DataType::FLOAT;
-       else if (type_str == "TEXT") schema[col_name] = DataType::TEXT;
-       else throw std::runtime_error("Unknown type: " + type_str);
-       cursor++;
 
-       if (typeid(*peek()) == typeid(token::Punctuation)) {
-           auto p = std::dynamic_pointer_cast<token::Punctuation>(peek())->str();
+       if (peek().type == token::Type::Punctuation) {
+           auto p = peek().text;
            if (p == ")") {
                cursor++;
                break;
@@ -269,21 +406,22 @@ Schema SqlInterpreter::read_schema() {
        throw std::runtime_error("Expected , or ) in schema");
    }
    
-   return schema;
+   decimals.resize(schema.size());
+   return {schema, primary_key, decimals};
 }
 
 std::vector<std::string> SqlInterpreter::read_select_list() {
    std::vector<std::string> columns;
    
    while (true) {
-       if (typeid(*peek()) != typeid(token::Identifier)) {
+       if (peek().type != token::Type::Identifier) {
            throw std::runtime_error("Expected column name in SELECT");
        }
-       columns.push_back(std::dynamic_pointer_cast<token::Identifier>(peek())->str());
+       columns.push_back(peek().str());
        cursor++;
 
-       if (typeid(*peek()) == typeid(token::Punctuation) &&
-           std::dynamic_pointer_cast<token::Punctuation>(peek())->str() == ",") {
+       if (peek().type == token::Type::Punctuation &&
+           peek().text == ",") {
            cursor++;
            continue;
        }
@@ -297,13 +435,13 @@ NamedVector<ExprPtr> SqlInterpreter::read_set() {
    NamedVector<ExprPtr> assignments;
    
    while (true) {
-       if (typeid(*peek()) != typeid(token::Identifier)) {
+       if (peek().type != token::Type::Identifier) {
            throw std::runtime_error("Expected column name in SET");
        }
-       auto col = std::dynamic_pointer_cast<token::Identifier>(peek())->str();
+       auto col = peek().str();
        cursor++;
        
-       if (std::dynamic_pointer_cast<token::Operator>(peek())->str() != "=") {
+       if (peek().text != "=") {
            throw std::runtime_error("Expected = after column name");
        }
        cursor++;
@@ -311,8 +449,8 @@ NamedVector<ExprPtr> SqlInterpreter::read_set() {
        auto expr = read_expr();
        assignments[col] = expr;
 
-       if (typeid(*peek()) == typeid(token::Punctuation) &&
-           std::dynamic_pointer_cast<token::Punctuation>(peek())->str() == ",") {
+       if (peek().type == token::Type::Punctuation &&
+           peek().text == ",") {
            cursor++;
            continue;
        }
@@ -322,37 +460,168 @@ NamedVector<ExprPtr> SqlInterpreter::read_set() {
    return assignments;
 }
 
+// Statement text for statistics: whitespace runs collapsed, long text cut short.
+static std::string shorten_statement(std::string_view text) {
+    std::string result;
+    for (char c : text) {
+        bool space = std::isspace(static_cast<unsigned char>(c));
+        if (space && (result.empty() || result.back() == ' ')) continue;
+        result += space ? ' ' : c;
+        if (result.size() >= 120) return result + "...";
+    }
+    while (!result.empty() && result.back() == ' ') result.pop_back();
+    return result;
+}
+
 // sql_handle.cpp
 void SqlInterpreter::execute(const std::string& sql) {
     outputTables.clear();
-    tokens = tokenize(cleanse(sql));
-    cursor = tokens.begin();
-    
-    while (cursor != tokens.end()) {
-        if (typeid(*peek()) != typeid(token::Keyword)) {
-            throw std::runtime_error("Expected command keyword");
+    statement_arena = &arena;
+    try {
+        auto tokenizing = StatsClock::now();
+        tokens = tokenize(sql, &token_arena);
+        double tokenize_ms = elapsed_ms(tokenizing);
+        cursor = tokens.begin();
+
+        while (cursor != tokens.end()) {
+            arena.release();  // the previous statement's temporaries are dead by now
+            if (peek().type != token::Type::Keyword) {
+                throw std::runtime_error("Expected command keyword");
+            }
+            
+            auto first = cursor;
+            auto cmd = peek().str();
+            cursor++;
+            if (cmd == "SHOW") {
+                parse_show();  // reads the statistics without adding to them
+                continue;
+            }
+
+            StatementStats stats;
+            stats.tokenize_ms = tokenize_ms;  // the text is tokenized up front; the first statement carries it
+            tokenize_ms = 0;
+            auto last = first;
+            while (last + 1 != tokens.end() && last->text != ";") last++;
+            stats.statement = shorten_statement(
+                std::string_view(first->text.data(), last->text.data() + last->text.size() - first->text.data()));
+            measure(stats, [&] {
+                // the output is set to None at beginning of commands. SELECT sets it to result at the end.
+                if (cmd == "CREATE") parse_create();
+                else if (cmd == "USE") parse_use();
+                else if (cmd == "DROP") parse_drop();
+                else if (cmd == "INSERT") parse_insert();
+                else if (cmd == "SELECT") parse_select();
+                else if (cmd == "UPDATE") parse_update();
+                else if (cmd == "DELETE") parse_delete();
+                else if (cmd == "COPY") parse_copy();
+                else if (cmd == "EXPLAIN") parse_explain();
+                else if (cmd == "ANALYZE") parse_analyze();
+                else throw std::runtime_error("Unknown command: " + cmd);
+            });
         }
-        
-        auto cmd = std::dynamic_pointer_cast<token::Keyword>(peek())->str();
-        cursor++;
-        
-         // the output is set to None at beginning of commands. SELECT sets it to result at the end.
-        if (cmd == "CREATE") parse_create();
-        else if (cmd == "USE") parse_use();
-        else if (cmd == "DROP") parse_drop();
-        else if (cmd == "INSERT") parse_insert();
-        else if (cmd == "SELECT") parse_select();
-        else if (cmd == "UPDATE") parse_update();
-        else if (cmd == "DELETE") parse_delete();
-        else throw std::runtime_error("Unknown command: " + cmd);
+    } catch (...) {
+        release_arena();
+        throw;
+    }
+    release_arena();
+}
+
+// Frees everything execute() or prepare() took from the arenas. The results and
+// prepared statements they leave behind are on the heap; the tokens are dropped.
+void SqlInterpreter::release_arena() {
+    statement_arena = nullptr;
+    tokens = token::TokenList(&token_arena);
+    cursor = tokens.end();
+    arena.release();
+    token_arena.release();
+}
+
+// Runs one statement with `stats` collecting its counters and records them,
+// also when the statement fails.
+void SqlInterpreter::measure(StatementStats& stats, const std::function<void()>& work) {
+    size_t outputs = outputTables.size();
+    uint64_t allocated = allocated_bytes();
+    auto start = StatsClock::now();
+    current_stats = &stats;
+    auto finish = [&] {
+        current_stats = nullptr;
+        stats.execute_ms = std::max(0.0, elapsed_ms(start) - stats.parse_ms - stats.plan_ms - stats.persist_ms);
+        stats.bytes_allocated = allocated_bytes() - allocated;
+        for (size_t i = outputs; i < outputTables.size(); i++) stats.rows_output += outputTables[i].rows->size();
+        statement_stats.push_back(stats);
+    };
+    try {
+        work();
+    } catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+}
+
+void SqlInterpreter::note_parse(StatsClock::time_point start) {
+    if (current_stats) current_stats->parse_ms += elapsed_ms(start);
+}
+
+// SHOW STATS; lists the counters of the statements run so far. bytes_allocated
+// is only listed in builds that count allocations (see ALLOCATIONS_COUNTED).
+void SqlInterpreter::parse_show() {
+    expect("STATS", "Expected STATS after SHOW");
+    expect(";", "Missing semicolon after SHOW STATS");
+    Schema schema;
+    schema["statement"] = DataType::TEXT;
+    for (auto name : {"tokenize_ms", "parse_ms", "plan_ms", "execute_ms", "persist_ms"}) schema[name] = DataType::FLOAT;
+    schema["rows_scanned"] = DataType::BIGINT;
+    schema["rows_output"] = DataType::BIGINT;
+    if (ALLOCATIONS_COUNTED) schema["bytes_allocated"] = DataType::BIGINT;
+    schema["disk_bytes_read"] = DataType::BIGINT;
+    schema["disk_bytes_written"] = DataType::BIGINT;
+    Table result("stats", schema);
+    std::vector<Row> rows;
+    for (auto& s : statement_stats) {
+        Row row(schema);
+        std::vector<CellData> values = {
+            CellData(s.statement), CellData(s.tokenize_ms), CellData(s.parse_ms), CellData(s.plan_ms),
+            CellData(s.execute_ms), CellData(s.persist_ms), CellData::bigint(s.rows_scanned),
+            CellData::bigint(s.rows_output)};
+        if (ALLOCATIONS_COUNTED) values.push_back(CellData::bigint(s.bytes_allocated));
+        values.push_back(CellData::bigint(s.disk_bytes_read));
+        values.push_back(CellData::bigint(s.disk_bytes_written));
+        for (size_t c = 0; c < schema.size(); c++) row.cells.elements[c].value = values[c];
+        rows.push_back(std::move(row));
     }
+    result.append_rows(std::move(rows));
+    outputTables.push_back(result);
+}
+
+// A query result's columns for a new table: named without the table prefix joins
+// add unless that makes two alike, DECIMAL ones with the largest scale stored.
+static Schema result_schema(const Table& result, std::vector<DecimalSpec>& decimals) {
+    auto& columns = result.schema.elements;
+    auto unqualified = [](const std::string& name) { return name.substr(name.rfind('.') + 1); };
+    Schema schema;
+    for (size_t i = 0; i < columns.size(); i++) {
+        std::string name = unqualified(columns[i].name);
+        size_t alike = std::count_if(columns.begin(), columns.end(), [&](auto& c) { return unqualified(c.name) == name; });
+        if (alike > 1) {
+            name = columns[i].name;
+            std::replace(name.begin(), name.end(), '.', '_');
+        }
+        schema[name] = columns[i].value;
+        DecimalSpec spec{CellData::MAX_DECIMAL_DIGITS, 0};
+        if (columns[i].value == DataType::DECIMAL) {
+            for (auto& row : *result.rows) spec.scale = std::max(spec.scale, row.cells.elements[i].value.scale());
+        }
+        decimals.push_back(spec);
+    }
+    return schema;
 }
 
 void SqlInterpreter::parse_create() {
     try {
-        auto type = read_token<token::Keyword>().str();
+        auto type = read_token(token::Type::Keyword).str();
         if (type == "DATABASE") {
-            auto name = read_token<token::Identifier>().str();
+            auto name = read_token(token::Type::Identifier).str();
             expect(";", "Missing semicolon after CREATE DATABASE");
             
             // Just create the database, don't select it
@@ -363,15 +632,38 @@ void SqlInterpreter::parse_create() {
         }
         else if (type == "TABLE") {
             if (!current_db) throw std::runtime_error("No database selected");
-            auto name = read_token<token::Identifier>().str();
-            auto schema = read_schema();
-            expect(";", "Missing semicolon after CREATE TABLE");
-            current_db->create_table(name, schema);
+            auto name = read_token(token::Type::Identifier).str();
+            if (peek().text == "AS") {
+                cursor++;
+                expect("SELECT", "Expected SELECT after CREATE TABLE ... AS");
+                auto query = read_select();
+                Table result = plan(query)->execute().table;
+                std::vector<DecimalSpec> decimals;
+                auto schema = result_schema(result, decimals);
+                append_result(current_db->create_table(name, schema, "", decimals), result);
+            } else {
+                auto [schema, primary_key, decimals] = read_schema();
+                expect(";", "Missing semicolon after CREATE TABLE");
+                current_db->create_table(name, schema, primary_key, decimals);
+            }
             
             // Save database after creating new table
             storage.save_database(*current_db, current_db_name);
         }
-        else throw std::runtime_error("Expected DATABASE or TABLE after CREATE");
+        else if (type == "BITMAP") {
+            if (!current_db) throw std::runtime_error("No database selected");
+            expect("INDEX", "Expected INDEX after CREATE BITMAP");
+            expect("ON", "Expected ON after CREATE BITMAP INDEX");
+            auto table_name = read_token(token::Type::Identifier).str();
+            expect("(", "Expected ( after table name");
+            auto col_name = read_token(token::Type::Identifier).str();
+            expect(")", "Expected ) after column name");
+            expect(";", "Missing semicolon after CREATE BITMAP INDEX");
+            current_db->get_table(table_name).create_bitmap_index(col_name);
+            current_db->schema_version++;
+            storage.save_database(*current_db, current_db_name);
+        }
+        else throw std::runtime_error("Expected DATABASE, TABLE or BITMAP INDEX after CREATE");
     } catch (const std::bad_cast&) {
         throw std::runtime_error("Invalid CREATE syntax");
     }
@@ -380,7 +672,7 @@ void SqlInterpreter::parse_create() {
 void SqlInterpreter::parse_use() {
     try {
         expect("DATABASE", "Expected DATABASE after USE");
-        auto name = read_token<token::Identifier>().str();
+        auto name = read_token(token::Type::Identifier).str();
         expect(";", "Missing semicolon after USE DATABASE");
         
         // Close and save current database before loading new one
@@ -396,15 +688,15 @@ void SqlInterpreter::parse_use() {
 
 void SqlInterpreter::parse_drop() {
     try {
-        auto type = read_token<token::Keyword>().str();
+        auto type = read_token(token::Type::Keyword).str();
         if (type == "DATABASE") {
-            auto name = read_token<token::Identifier>().str();
+            auto name = read_token(token::Type::Identifier).str();
             expect(";", "Missing semicolon after DROP DATABASE");
             storage.delete_database(name);
         }
         else if (type == "TABLE") {
             if (!current_db) throw std::runtime_error("No database selected");
-            auto name = read_token<token::Identifier>().str();
+            auto name = read_token(token::Type::Identifier).str();
             expect(";", "Missing semicolon after DROP TABLE");
             current_db->drop_table(name);
         }
@@ -415,139 +707,467 @@ void SqlInterpreter::parse_drop() {
 }
 
 void SqlInterpreter::parse_insert() {
+    auto start = StatsClock::now();
+    auto stmt = read_insert();
+    note_parse(start);
+    run(stmt);
+}
+
+void SqlInterpreter::parse_select() {
+    auto start = StatsClock::now();
+    auto stmt = read_select();
+    note_parse(start);
+    run(stmt);
+}
+
+void SqlInterpreter::parse_update() {
+    auto start = StatsClock::now();
+    auto stmt = read_update();
+    note_parse(start);
+    run(stmt);
+}
+
+void SqlInterpreter::parse_delete() {
+    auto start = StatsClock::now();
+    auto stmt = read_delete();
+    note_parse(start);
+    run(stmt);
+}
+
+// COPY table FROM 'file.csv';  or  COPY table TO 'file.csv';
+void SqlInterpreter::parse_copy() {
     try {
-        expect("INTO", "Expected INTO after INSERT");
-        auto table_name = read_token<token::Identifier>().str();
-        expect("VALUES", "Expected VALUES after table name");
-        auto values = read_values();
-        expect(";", "Missing semicolon after INSERT");
+        if (!current_db) throw std::runtime_error("No database selected");
+        auto table_name = read_token(token::Type::Identifier).str();
+        auto direction = peek().text;
+        if (direction != "FROM" && direction != "TO") {
+            throw std::runtime_error("Expected FROM or TO after COPY table");
+        }
+        cursor++;
+        auto path = read_token(token::Type::Literal).str();
+        expect(";", "Missing semicolon after COPY");
 
         auto& table = current_db->get_table(table_name);
-        if (values.size() != table.schema.size()) {
-            throw std::runtime_error("Value count mismatch");
+        if (direction == "FROM") {
+            csv_copy_from(table, path);
+            if (current_stats) current_stats->disk_bytes_read += file_bytes(path);
+        } else {
+            csv_copy_to(table, path);
+            if (current_stats) current_stats->disk_bytes_written += file_bytes(path);
         }
+    } catch (const std::bad_cast&) {
+        throw std::runtime_error("Invalid COPY syntax");
+    }
+}
 
-        Row row(table.schema);
-        for (size_t i = 0; i < values.size(); i++) {
-            row.cells[table.schema.elements[i].name] = values[i];
+InsertStatement SqlInterpreter::read_insert() {
+    try {
+        InsertStatement stmt;
+        expect("INTO", "Expected INTO after INSERT");
+        stmt.table = read_token(token::Type::Identifier).str();
+        if (peek().text == "SELECT") {
+            cursor++;
+            stmt.select = make_temp<SelectStatement>(read_select());
+            return stmt;
+        }
+        expect("VALUES", "Expected VALUES or SELECT after table name");
+        // VALUES (...), (...), ...
+        while (true) {
+            stmt.rows.push_back(read_values(stmt.rows.size(), stmt.params));
+            if (peek().text != ",") break;
+            cursor++;
         }
-        table.append_row(row);
+        expect(";", "Missing semicolon after INSERT");
+        return stmt;
     } catch (const std::bad_cast&) {
         throw std::runtime_error("Invalid INSERT syntax");
     }
 }
 
-void SqlInterpreter::parse_select() {
+SelectStatement SqlInterpreter::read_select(bool nested) {
     try {
-        std::vector<std::string> cols;
-        if (peek()->str() == "*") {
+        SelectStatement stmt;
+        if (peek().text == "DISTINCT") {
+            cursor++;
+            stmt.distinct = true;
+        }
+        if (peek().text == "*") {
             cursor++;
         } else {
-            cols = read_select_list();
+            stmt.columns = read_select_list();
         }
         
         expect("FROM", "Expected FROM after SELECT");
-        auto table_name = read_token<token::Identifier>().str();
+        stmt.table = read_token(token::Type::Identifier).str();
         
-        // Get initial table
-        auto& base_table = current_db->get_table(table_name);
-        Table result = base_table;  // Start with base table
-        
-        // Check for WHERE or INNER JOIN or semicolon
-        if (cursor != tokens.end()) {
-            if (peek()->str() == "INNER") {
-                cursor++;
-                expect("JOIN", "Expected JOIN after INNER");
-                
-                // Get the table to join with
-                auto join_table_name = read_token<token::Identifier>().str();
-                auto& join_table = current_db->get_table(join_table_name);
-                
-                expect("ON", "Expected ON after INNER JOIN table");
-                
-                // Read the join condition
-                ExprPtr join_condition = read_condition();
-                
-                // Perform the join and filter
-                result = result.join(join_table).where(join_condition);
-                
-                // Now look for WHERE or semicolon
-                if (cursor != tokens.end() && peek()->str() == "WHERE") {
-                    cursor++;
-                    ExprPtr where_condition = read_condition();
-                    result = result.where(where_condition);
-                }
-                
-                expect(";", "Missing semicolon after JOIN clause");
-            }
-            else if (peek()->str() == "WHERE") {
-                cursor++;
-                ExprPtr condition = read_condition();
-                result = result.where(condition);
-                expect(";", "Missing semicolon after WHERE clause");
-            }
-            else {
-                expect(";", "Missing semicolon after FROM clause");
-            }
+        if (cursor == tokens.end()) return stmt;  // the semicolon may be left off the last statement
+
+        // Any number of [INNER] JOIN ... ON ..., then WHERE or semicolon
+        while (cursor != tokens.end() && (peek().text == "INNER" || peek().text == "JOIN")) {
+            if (peek().text == "INNER") cursor++;
+            expect("JOIN", "Expected JOIN after INNER");
+            SelectStatement::Join join;
+            join.table = read_token(token::Type::Identifier).str();
+            expect("ON", "Expected ON after JOIN table");
+            join.condition = read_expr();
+            stmt.joins.push_back(join);
         }
-        
-        // Add result to output
-        if (cols.empty()) { // * case
-            outputTables.push_back(result);
-        } else {
-            outputTables.push_back(result.select(cols));
+        if (cursor != tokens.end() && peek().text == "WHERE") {
+            cursor++;
+            stmt.where = read_expr();
         }
-        
+        if (nested) return stmt;
+        expect(";", stmt.where ? "Missing semicolon after WHERE clause"
+                   : stmt.joins.empty() ? "Missing semicolon after FROM clause" : "Missing semicolon after JOIN clause");
+        return stmt;
     } catch (const std::bad_cast&) {
         throw std::runtime_error("Invalid SELECT syntax");
     }
 }
 
-void SqlInterpreter::parse_update() {
+UpdateStatement SqlInterpreter::read_update() {
     try {
-        auto table_name = read_token<token::Identifier>().str();
+        UpdateStatement stmt;
+        stmt.table = read_token(token::Type::Identifier).str();
         expect("SET", "Expected SET after table name");
-        auto assignments = read_set();
+        stmt.assignments = read_set();
         
-        ExprPtr condition;
-        if (cursor != tokens.end() && peek()->str() == "WHERE") {
+        if (cursor != tokens.end() && peek().text == "WHERE") {
             cursor++;
-            condition = read_condition();
+            stmt.where = read_expr();
         }
         expect(";", "Missing semicolon after UPDATE");
-
-        auto& table = current_db->get_table(table_name);
-        if (condition) {
-            table.update_where(condition, assignments);
-        } else {
-            table.update_where(literal(1), assignments);
-        }
+        return stmt;
     } catch (const std::bad_cast&) {
         throw std::runtime_error("Invalid UPDATE syntax");
     }
 }
 
-void SqlInterpreter::parse_delete() {
+DeleteStatement SqlInterpreter::read_delete() {
     try {
+        DeleteStatement stmt;
         expect("FROM", "Expected FROM after DELETE");
-        auto table_name = read_token<token::Identifier>().str();
+        stmt.table = read_token(token::Type::Identifier).str();
         
-        ExprPtr condition;
-        if (cursor != tokens.end() && peek()->str() == "WHERE") {
+        if (cursor != tokens.end() && peek().text == "WHERE") {
             cursor++;
-            condition = read_condition();
+            stmt.where = read_expr();
         }
         expect(";", "Missing semicolon after DELETE");
+        return stmt;
+    } catch (const std::bad_cast&) {
+        throw std::runtime_error("Invalid DELETE syntax");
+    }
+}
 
-        auto& table = current_db->get_table(table_name);
-        if (condition) {
-            table.delete_where(condition);
+// Appends a query's rows to a stored table in one batch. Columns are checked
+// against the schema once: values are converted only in columns whose type
+// differs, and in DECIMAL ones, which must fit the column's precision and scale.
+void SqlInterpreter::append_result(Table& table, const Table& result) {
+    auto& columns = table.schema.elements;
+    if (result.schema.size() != columns.size()) throw std::runtime_error("Value count mismatch");
+    std::vector<bool> convert;
+    for (size_t i = 0; i < columns.size(); i++) {
+        convert.push_back(columns[i].value == DataType::DECIMAL || result.schema.elements[i].value != columns[i].value);
+    }
+    std::vector<Row> batch;
+    batch.reserve(result.rows->size());
+    for (auto& source : *result.rows) {
+        Row row(table.schema);
+        for (size_t i = 0; i < columns.size(); i++) {
+            auto& value = source.cells.elements[i].value;
+            row.cells.elements[i].value = convert[i] ? table.coerce(i, value) : value;
+        }
+        batch.push_back(std::move(row));
+    }
+    table.append_rows(std::move(batch));
+}
+
+void SqlInterpreter::run(InsertStatement& stmt) {
+    if (!current_db) throw std::runtime_error("No database selected");
+    auto& table = current_db->get_table(stmt.table);
+    if (stmt.select) {
+        append_result(table, plan(*stmt.select)->execute().table);
+        return;
+    }
+    auto& columns = table.schema.elements;
+
+    // rows are laid out like the schema, so values go in by position, converted
+    // to the column's type
+    std::vector<Row> batch;
+    batch.reserve(stmt.rows.size());
+    for (auto& values : stmt.rows) {
+        if (values.size() != columns.size()) {
+            throw std::runtime_error("Value count mismatch");
+        }
+        Row row(table.schema);
+        for (size_t i = 0; i < values.size(); i++) {
+            // a number written with a point is a FLOAT outside DECIMAL columns
+            bool as_float = values[i].type == DataType::DECIMAL && columns[i].value != DataType::DECIMAL;
+            row.cells.elements[i].value = table.coerce(i, as_float ? CellData(DataType::FLOAT, values[i]) : values[i]);
+        }
+        batch.push_back(std::move(row));
+    }
+    for (auto& slot : stmt.params) {
+        batch[slot.row].cells.elements[slot.column].value = table.coerce(slot.column, slot.param->value());
+    }
+    table.append_rows(std::move(batch));
+}
+
+// Removes the subqueries from a WHERE's AND-ed terms, leaving the rest in `where`.
+static std::vector<std::shared_ptr<Subquery>> take_subqueries(ExprPtr& where) {
+    std::vector<std::shared_ptr<Subquery>> subqueries;
+    if (where.get() == nullptr) return subqueries;
+    std::vector<ExprPtr> rest;
+    for (auto& term : conjuncts(where)) {
+        if (auto subquery = std::dynamic_pointer_cast<Subquery>(term)) subqueries.push_back(subquery);
+        else rest.push_back(term);
+    }
+    where = conjunction(rest);
+    return subqueries;
+}
+
+// Each subquery is planned on its own and filters `input` once it has run.
+// A subquery may only read columns of the tables it names itself; any other
+// column would be the outer query's, which would need a correlated plan.
+static void check_uncorrelated(Database& db, SelectStatement& stmt) {
+    std::vector<Table*> tables = {&db.get_table(stmt.table)};
+    for (auto& join : stmt.joins) tables.push_back(&db.get_table(join.table));
+    auto resolves = [&](const std::string& name) {
+        for (auto table : tables) {
+            std::string prefix = table->name + ".";
+            bool qualified = name.compare(0, prefix.size(), prefix) == 0;
+            for (auto& column : table->schema.elements) {
+                if (column.name == (qualified ? name.substr(prefix.size()) : name)) return true;
+            }
+        }
+        return false;
+    };
+    std::vector<std::string> names = stmt.columns;
+    auto add = [&](ExprPtr expr) {
+        if (expr.get() == nullptr) return;
+        auto read = column_names(expr);
+        names.insert(names.end(), read.begin(), read.end());
+    };
+    add(stmt.where);
+    for (auto& join : stmt.joins) add(join.condition);
+    for (auto& name : names) {
+        if (!resolves(name)) throw std::runtime_error("correlated subqueries are not supported (column " + name + ")");
+    }
+}
+
+PlanPtr SqlInterpreter::semi_joins(PlanPtr input, const std::vector<std::shared_ptr<Subquery>>& subqueries) {
+    for (auto& subquery : subqueries) {
+        check_uncorrelated(*current_db, *subquery->query);
+        input = make_temp<SemiJoinNode>(input, plan(*subquery->query), subquery->operand, subquery->negated);
+    }
+    return input;
+}
+
+// Filters on a single table run inside its scan, where the indexes can answer
+// them. Joins are ordered by the planner to keep intermediate results small.
+PlanPtr SqlInterpreter::plan(SelectStatement& stmt) {
+    if (!current_db) throw std::runtime_error("No database selected");
+    auto& base_table = current_db->get_table(stmt.table);
+    ExprPtr where = stmt.where;
+    auto subqueries = take_subqueries(where);
+    auto distinct = [&](PlanPtr project) -> PlanPtr {
+        return stmt.distinct ? make_temp<DistinctNode>(project) : project;
+    };
+    if (stmt.joins.empty()) {
+        auto scan = make_temp<ScanNode>(base_table, where);
+        return distinct(make_temp<ProjectNode>(semi_joins(scan, subqueries), stmt.columns));
+    }
+    std::vector<Table*> tables = {&base_table};
+    std::vector<ExprPtr> conditions;
+    for (auto& join : stmt.joins) {
+        tables.push_back(&current_db->get_table(join.table));
+        conditions.push_back(join.condition);
+    }
+    if (where) conditions.push_back(where);
+    JoinPlanner planner(tables, conjunction(conditions));
+    planner.memory_budget = join_memory_budget;
+    auto order = planner.order();
+    // joined columns come in join order; * lists them in the order the tables are named
+    auto columns = stmt.columns;
+    if (columns.empty() && !std::is_sorted(order.begin(), order.end())) {
+        for (auto table : tables) {
+            for (auto& column : table->schema.elements) columns.push_back(table->name + "." + column.name);
+        }
+    }
+    return distinct(make_temp<ProjectNode>(semi_joins(planner.build(order), subqueries), columns));
+}
+
+PlanPtr SqlInterpreter::plan(UpdateStatement& stmt) {
+    if (!current_db) throw std::runtime_error("No database selected");
+    auto& table = current_db->get_table(stmt.table);
+    ExprPtr where = stmt.where;
+    auto subqueries = take_subqueries(where);
+    auto input = semi_joins(make_temp<ScanNode>(table, where), subqueries);
+    return make_temp<UpdateNode>(input, table, stmt.assignments);
+}
+
+PlanPtr SqlInterpreter::plan(DeleteStatement& stmt) {
+    if (!current_db) throw std::runtime_error("No database selected");
+    auto& table = current_db->get_table(stmt.table);
+    ExprPtr where = stmt.where;
+    auto subqueries = take_subqueries(where);
+    return make_temp<DeleteNode>(semi_joins(make_temp<ScanNode>(table, where), subqueries), table);
+}
+
+PlanPtr SqlInterpreter::plan(InsertStatement& stmt) {
+    return plan(*stmt.select);
+}
+
+void SqlInterpreter::run(SelectStatement& stmt) {
+    outputTables.push_back(plan(stmt)->execute().table);
+}
+
+void SqlInterpreter::run(UpdateStatement& stmt) {
+    plan(stmt)->execute();
+}
+
+void SqlInterpreter::run(DeleteStatement& stmt) {
+    plan(stmt)->execute();
+}
+
+// Runs an already planned statement; UPDATE and DELETE plans apply their own changes.
+void SqlInterpreter::run(Statement& stmt, PlanPtr root) {
+    auto result = root->execute();
+    if (std::holds_alternative<SelectStatement>(stmt)) outputTables.push_back(result.table);
+    if (auto insert = std::get_if<InsertStatement>(&stmt)) {
+        append_result(current_db->get_table(insert->table), result.table);
+    }
+}
+
+// ANALYZE [table]; gathers the statistics the planner uses, for one table or all
+// of them, and saves them with the database.
+void SqlInterpreter::parse_analyze() {
+    if (!current_db) throw std::runtime_error("No database selected");
+    try {
+        if (peek().text == ";") {
+            for (auto& [name, table] : current_db->tables) table.analyze();
         } else {
-            table.delete_where(literal(1));
+            current_db->get_table(read_token(token::Type::Identifier).str()).analyze();
         }
+        expect(";", "Missing semicolon after ANALYZE");
     } catch (const std::bad_cast&) {
-        throw std::runtime_error("Invalid DELETE syntax");
+        throw std::runtime_error("Invalid ANALYZE syntax");
     }
+    current_db->schema_version++;
+    storage.save_database(*current_db, current_db_name);
+}
+
+// EXPLAIN [ANALYZE] SELECT|UPDATE|DELETE ...; shows the operator tree. ANALYZE
+// also runs the statement (so UPDATE and DELETE do change the table) and adds
+// each operator's actual rows, time and memory.
+void SqlInterpreter::parse_explain() {
+    bool analyze = peek().text == "ANALYZE";
+    if (analyze) cursor++;
+    auto kind = peek().str();
+    cursor++;
+    auto start = StatsClock::now();
+    PlanPtr root;
+    if (kind == "SELECT") {
+        auto stmt = read_select();
+        note_parse(start);
+        root = plan(stmt);
+    } else if (kind == "UPDATE") {
+        auto stmt = read_update();
+        note_parse(start);
+        root = plan(stmt);
+    } else if (kind == "DELETE") {
+        auto stmt = read_delete();
+        note_parse(start);
+        root = plan(stmt);
+    } else {
+        throw std::runtime_error("EXPLAIN supports SELECT, UPDATE and DELETE");
+    }
+    if (analyze) root->execute(true);
+    outputTables.push_back(explain_table(root));
+}
+
+void PreparedStatement::bind(size_t index, CellData value) {
+    if (index >= params->size()) {
+        throw std::runtime_error("Parameter index " + std::to_string(index) + " out of range");
+    }
+    (*params)[index] = value;
+}
+
+// Parses a single INSERT, SELECT, UPDATE or DELETE (the trailing semicolon is
+// optional) whose `?` placeholders are bound before each execute().
+std::shared_ptr<PreparedStatement> SqlInterpreter::prepare(const std::string& sql) {
+    auto prepared = std::make_shared<PreparedStatement>();
+    prepared->text = shorten_statement(sql);
+    tokens = tokenize(sql, &token_arena);
+    if (tokens.empty() || tokens.back().text != ";") {
+        tokens.push_back({token::Type::Punctuation, ";"});
+    }
+    cursor = tokens.begin();
+    params = prepared->params;
+    // the tokens view into `sql`, which the caller may free once this returns
+    auto done = [&] {
+        params = nullptr;
+        release_arena();
+    };
+    try {
+        auto cmd = read_token(token::Type::Keyword).text;
+        if (cmd == "INSERT") prepared->statement = read_insert();
+        else if (cmd == "SELECT") prepared->statement = read_select();
+        else if (cmd == "UPDATE") prepared->statement = read_update();
+        else if (cmd == "DELETE") prepared->statement = read_delete();
+        else throw std::runtime_error("Only INSERT, SELECT, UPDATE and DELETE can be prepared");
+        if (cursor != tokens.end()) throw std::runtime_error("Only one statement can be prepared");
+    } catch (const std::bad_cast&) {
+        done();
+        throw std::runtime_error("Expected command keyword");
+    } catch (...) {
+        done();
+        throw;
+    }
+    done();
+    return prepared;
+}
+
+// The statistics versions of the tables a plan scans, which it was costed with.
+static std::vector<std::pair<const Table*, uint64_t>> scanned_stats(PlanPtr root) {
+    std::vector<std::pair<const Table*, uint64_t>> result;
+    std::vector<PlanPtr> pending{root};
+    while (!pending.empty()) {
+        PlanPtr node = pending.back();
+        pending.pop_back();
+        if (auto scan = std::dynamic_pointer_cast<ScanNode>(node)) result.push_back({&scan->table, scan->table.stats->version});
+        pending.insert(pending.end(), node->children.begin(), node->children.end());
+    }
+    return result;
+}
+
+// Tables are only dropped along with a schema_version change, so the pointers
+// are good while that holds.
+static bool stats_refreshed(const std::vector<std::pair<const Table*, uint64_t>>& planned) {
+    for (auto& [table, version] : planned) {
+        if (table->stats->version != version) return true;
+    }
+    return false;
+}
+
+void SqlInterpreter::execute(PreparedStatement& prepared) {
+    outputTables.clear();
+    StatementStats stats;
+    stats.statement = prepared.text;
+    measure(stats, [&] {
+        auto insert = std::get_if<InsertStatement>(&prepared.statement);
+        if (insert && !insert->select) return run(*insert);
+        if (!current_db) throw std::runtime_error("No database selected");
+        if (prepared.plan.get() == nullptr || prepared.planned_db.lock() != current_db ||
+            prepared.planned_version != current_db->schema_version || stats_refreshed(prepared.planned_stats)) {
+            prepared.plan = std::visit([this](auto& stmt) { return plan(stmt); }, prepared.statement);
+            prepared.planned_db = current_db;
+            prepared.planned_version = current_db->schema_version;
+            prepared.planned_stats = scanned_stats(prepared.plan);
+        }
+        run(prepared.statement, prepared.plan);
+    });
 }
 
 void SqlInterpreter::expect(const std::string& token_expected, const std::string& error_msg) {
@@ -557,11 +1177,72 @@ void SqlInterpreter::expect(const std::string& token_expected, const std::string
             error_msg);
     }
     
-    if (peek()->str() != token_expected) {
+    if (peek().text != token_expected) {
         throw std::runtime_error(error_msg.empty() ?
-            "Expected " + token_expected + ", found: " + peek()->str() :
+            "Expected " + token_expected + ", found: " + peek().str() :
             error_msg);
     }
     cursor++;
 }
 
+// Reads the script in fixed-size chunks and hands execute() one statement at a
+// time, so memory stays bounded by the longest statement instead of the file.
+// Each SELECT result is written to the output stream as soon as it completes.
+void SqlInterpreter::execute_file(const std::string& filepath) {
+    std::ifstream in(filepath, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Could not open input file " + filepath);
+    }
+
+    auto run = [this](std::string statement) {
+        execute(statement);
+        for (auto& table : outputTables) output_table(table);
+        outputTables.clear();
+    };
+
+    std::string pending;  // text read but not yet executed
+    size_t scan = 0;      // how far `pending` has been split
+    bool in_quote = false, in_comment = false;
+    std::vector<char> chunk(1 << 16);
+    while (true) {
+        in.read(chunk.data(), chunk.size());
+        size_t got = in.gcount();
+        pending.append(chunk.data(), got);
+        bool eof = got == 0;
+
+        // at a chunk edge a lone '-' might start a comment; look again once more text arrives
+        size_t start = 0;
+        size_t limit = eof ? pending.size() : pending.size() - 1;
+        for (; scan < limit; scan++) {
+            char c = pending[scan];
+            if (in_comment) {
+                if (c == '\n') in_comment = false;
+            } else if (c == '\'') {
+                in_quote = !in_quote;  // '' escapes close and reopen, which nets out
+            } else if (in_quote) {
+                continue;
+            } else if (c == '-' && scan + 1 < pending.size() && pending[scan + 1] == '-') {
+                in_comment = true;
+            } else if (c == ';') {
+                run(pending.substr(start, scan + 1 - start));
+                start = scan + 1;
+            }
+        }
+        pending.erase(0, start);
+        scan -= start;
+        if (eof) break;
+    }
+
+    // a final statement without its semicolon still runs, and reports it
+    if (pending.find_first_not_of(" \t\r\n") != std::string::npos) run(pending);
+}
+
+void SqlInterpreter::set_output(std::ofstream& out) {
+    output = &out;
+}
+
+void SqlInterpreter::output_table(const Table& table) {
+    if (!output) return;
+    *output << csv_dumps(table, false, true) << "---\n";
+    output->flush();
+}
@@ -7,69 +7,126 @@
 #include "table.hpp"
 #include "database.hpp"
 #include "disk_storage.hpp"
+#include "stats.hpp"
+#include "plan.hpp"
+#include "arena.hpp"
+#include <functional>
 #include <vector>
 #include <memory>
+#include <memory_resource>
 #include <sstream>
-#include <regex>
+#include <string_view>
 #include <unordered_set>
 #include <optional>
+#include <variant>
+#include <tuple>
 
 
 namespace token {
-    class Token {
-    public:
-        virtual ~Token() = default;
-        virtual std::string str() const = 0;
+    enum class Type {
+        Keyword,
+        Identifier,
+        Literal,
+        Operator,
+        Punctuation,
+        Parameter  // `?` in a prepared statement
     };
 
-    using TokenPtr = std::shared_ptr<Token>;
-    using TokenList = std::vector<TokenPtr>;
-
-    class Keyword : public Token {
-        std::string value;
-    public:
-        Keyword(std::string v) : value(std::move(v)) {}
-        std::string str() const override { return value; }
+    // Operator tag set by the lexer so the expression parser never compares text
+    enum class Op {
+        None,
+        Or, And, Not, In, Exists,
+        Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual,
+        Plus, Minus, Multiply, Divide
     };
 
-    class Identifier : public Token {
-        std::string value;
-    public:
-        Identifier(std::string v) : value(std::move(v)) {}
-        std::string str() const override { return value; }
-    };
+    // Tokens are views into the script being executed, so lexing copies nothing.
+    struct Token {
+        Type type;
+        std::string_view text;  // for quoted literals, the text between the quotes
+        bool quoted = false;
+        Op op = Op::None;
 
-    class Literal : public Token {
-        std::string value;
-    public:
-        Literal(std::string v) : value(std::move(v)) {}
-        std::string str() const override { return value; }
+        std::string str() const;
     };
 
-    class Operator : public Token {
-        std::string value;
-    public:
-        Operator(std::string v) : value(std::move(v)) {}
-        std::string str() const override { return value; }
+    using TokenList = std::pmr::vector<Token>;
+}
+
+extern const std::unordered_set<std::string_view> KEYWORDS;
+token::TokenList tokenize(std::string_view input, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+CellData literal_cell(token::Token token);
+
+// Parsed data statements. The parse_* methods read one from the tokens and run it
+// right away; prepare() keeps it to run again with other parameter values.
+struct InsertStatement {
+    struct ParamSlot {
+        size_t row, column;
+        std::shared_ptr<Param> param;
     };
 
-    class Punctuation : public Token {
-        char value;
-    public:
-        Punctuation(char v) : value(v) {}
-        std::string str() const override { return std::string(1, value); }
+    std::string table;
+    std::vector<std::vector<CellData>> rows;  // one per VALUES tuple, numbers with a point exact
+    std::vector<ParamSlot> params;            // value filled in by each `?`
+    std::shared_ptr<SelectStatement> select;  // INSERT INTO ... SELECT instead of VALUES
+};
+
+struct SelectStatement {
+    struct Join {
+        std::string table;
+        ExprPtr condition;
     };
-}
 
-// Declare but don't define
-extern const std::unordered_set<std::string> KEYWORDS;
-std::string cleanse(std::string input);
-token::TokenList tokenize(const std::string& input);
+    bool distinct = false;
+    std::vector<std::string> columns;  // empty for *
+    std::string table;
+    std::vector<Join> joins;  // [INNER] JOIN ... ON ..., in the order written
+    ExprPtr where;
+};
+
+struct UpdateStatement {
+    std::string table;
+    NamedVector<ExprPtr> assignments;
+    ExprPtr where;
+};
+
+struct DeleteStatement {
+    std::string table;
+    ExprPtr where;
+};
+
+using Statement = std::variant<InsertStatement, SelectStatement, UpdateStatement, DeleteStatement>;
+
+// A statement parsed once and executed many times. Values bound to its `?`
+// placeholders (numbered from 0 in order of appearance) stay until rebound.
+class PreparedStatement {
+public:
+    Statement statement;
+    std::shared_ptr<ParamValues> params = std::make_shared<ParamValues>();
+    std::string text;  // shortened SQL, for statistics
+    // Plan of an earlier execute(), reused while the same database is open, its
+    // schema_version is unchanged and no table the plan reads has been analyzed
+    // since. VALUES inserts have none.
+    PlanPtr plan;
+    std::weak_ptr<Database> planned_db;
+    uint64_t planned_version = 0;
+    std::vector<std::pair<const Table*, uint64_t>> planned_stats;  // each scanned table's stats version
+
+    size_t param_count() { return params->size(); }
+    void bind(size_t index, CellData value);
+};
 
 class SqlInterpreter {
 public:
     
-    token::TokenList tokens;
+    // The temporaries of the statement execute() is running come from `arena`,
+    // released in one go after each statement. The tokens of the whole text
+    // have their own, released when execute() or prepare() returns.
+    alignas(std::max_align_t) std::byte arena_buffer[64 * 1024];
+    std::pmr::monotonic_buffer_resource arena{arena_buffer, sizeof(arena_buffer)};
+    alignas(std::max_align_t) std::byte token_buffer[16 * 1024];
+    std::pmr::monotonic_buffer_resource token_arena{token_buffer, sizeof(token_buffer)};
+    token::TokenList tokens{&token_arena};
     token::TokenList::iterator cursor;
     std::shared_ptr<Database> current_db;
     std::string current_db_name;
@@ -77,34 +134,29 @@ public:
     DiskStorage storage;
     
     
-    const token::TokenPtr& peek() {
+    const token::Token& peek() {
         if (cursor == tokens.end()) {
             throw std::runtime_error("Unexpected end of input");
         }
         return *cursor;
     }
 
-    template<typename T>
-    T read_token() {
-        if (cursor == tokens.end()) {
-            throw std::runtime_error("Unexpected end of input");
-        }
-        
-        auto token = std::dynamic_pointer_cast<T>(peek());
-        if (!token) {
+    token::Token read_token(token::Type type) {
+        if (peek().type != type) {
             throw std::bad_cast();
         }
-        
-        cursor++;
-        return *token;
+        return *cursor++;
     }
 
 
     void expect(const std::string& str, const std::string& errormsg="");
+    void release_arena();
     
     // Statement parsers
     void execute(const std::string& sql);
     void execute_file(const std::string& filepath);
+    std::shared_ptr<PreparedStatement> prepare(const std::string& sql);
+    void execute(PreparedStatement& prepared);
     void parse_create();
     void parse_use();
     void parse_drop();
@@ -112,14 +164,38 @@ public:
     void parse_select();
     void parse_update();
     void parse_delete();
+    void parse_copy();
+    void parse_show();
+    void parse_explain();
+    void parse_analyze();
+    InsertStatement read_insert();
+    SelectStatement read_select(bool nested = false);  // nested: a subquery, ended by its `)`
+    UpdateStatement read_update();
+    DeleteStatement read_delete();
+    PlanPtr semi_joins(PlanPtr input, const std::vector<std::shared_ptr<Subquery>>& subqueries);
+    PlanPtr plan(InsertStatement& stmt);  // INSERT ... SELECT: plans the SELECT
+    PlanPtr plan(SelectStatement& stmt);
+    PlanPtr plan(UpdateStatement& stmt);
+    PlanPtr plan(DeleteStatement& stmt);
+    void append_result(Table& table, const Table& result);
+    void run(InsertStatement& stmt);
+    void run(SelectStatement& stmt);
+    void run(UpdateStatement& stmt);
+    void run(DeleteStatement& stmt);
+    void run(Statement& stmt, PlanPtr root);
     
     // Expression and clause parsing
-    ExprPtr read_expr();
-    ExprPtr parse_expr_range(token::TokenList::iterator start, token::TokenList::iterator end);
-    ExprPtr read_condition();
-    Schema read_schema();
+    ExprPtr read_expr(int min_precedence = 1);
+    ExprPtr read_operand();
+    bool at_in_list();
+    ExprPtr read_in_list(ExprPtr operand);
+    std::shared_ptr<SelectStatement> read_subquery();
+    std::shared_ptr<Param> read_param();
+    // schema, primary key column (may be empty) and per-column DECIMAL precision/scale
+    std::tuple<Schema, std::string, std::vector<DecimalSpec>> read_schema();
     std::vector<std::string> read_select_list();
-    std::vector<CellData> read_values();
+    std::vector<CellData> read_values(size_t row, std::vector<InsertStatement::ParamSlot>& params);
+    std::shared_ptr<ParamValues> params;  // placeholders of the statement being prepared
     NamedVector<ExprPtr> read_set();
     
     
@@ -137,6 +213,13 @@ public:
     }
     
     std::vector<Table> outputTables;
+    size_t join_memory_budget = JoinPlanner::DEFAULT_MEMORY_BUDGET;  // bytes a hash join may plan to use
+
+    // Counters of every statement run so far, oldest first
+    std::vector<StatementStats> statement_stats;
+    void measure(StatementStats& stats, const std::function<void()>& work);
+    void note_parse(StatsClock::time_point start);
+
     // Output handling
     void set_output(std::ofstream& out);
     void output_table(const Table& table);
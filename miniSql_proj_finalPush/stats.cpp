@@ -0,0 +1,81 @@
+#include "stats.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+
+thread_local StatementStats* current_stats = nullptr;
+
+#ifdef MINIDB_COUNT_ALLOCATIONS
+// A plain thread-local total, added to only while current_stats is set: other
+// threads and unmeasured work pay one thread-local load per allocation.
+static thread_local uint64_t thread_allocated = 0;
+
+static void* counted_alloc(std::size_t size, std::size_t alignment) {
+    if (current_stats) thread_allocated += size;
+    size = std::max<std::size_t>(size, 1);
+    void* p = alignment > alignof(std::max_align_t)
+        ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+        : std::malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+// Counting replacements of the global allocation functions; the array and
+// nothrow forms forward to these.
+void* operator new(std::size_t size) { return counted_alloc(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+uint64_t allocated_bytes() {
+    return thread_allocated;
+}
+#else
+uint64_t allocated_bytes() {
+    return 0;
+}
+#endif
+
+double elapsed_ms(StatsClock::time_point start) {
+    return std::chrono::duration<double, std::milli>(StatsClock::now() - start).count();
+}
+
+uint64_t file_bytes(const std::string& path) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    return ec ? 0 : size;
+}
+
+static void write_json_string(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20) out << ' ';
+        else out << c;
+    }
+    out << '"';
+}
+
+void write_stats_json(std::ostream& out, const std::vector<StatementStats>& stats) {
+    out << "{\"statements\": [";
+    for (size_t i = 0; i < stats.size(); i++) {
+        auto& s = stats[i];
+        out << (i ? ",\n  " : "\n  ") << "{\"statement\": ";
+        write_json_string(out, s.statement);
+        out << ", \"tokenize_ms\": " << s.tokenize_ms << ", \"parse_ms\": " << s.parse_ms
+            << ", \"plan_ms\": " << s.plan_ms << ", \"execute_ms\": " << s.execute_ms
+            << ", \"persist_ms\": " << s.persist_ms << ", \"rows_scanned\": " << s.rows_scanned
+            << ", \"rows_output\": " << s.rows_output;
+        if (ALLOCATIONS_COUNTED) out << ", \"bytes_allocated\": " << s.bytes_allocated;
+        out << ", \"disk_bytes_read\": " << s.disk_bytes_read
+            << ", \"disk_bytes_written\": " << s.disk_bytes_written << "}";
+    }
+    out << "\n]}\n";
+}
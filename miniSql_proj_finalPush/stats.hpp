@@ -0,0 +1,51 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// What one statement cost, phase by phase. Times are in milliseconds; execute
+// is whatever the other phases do not account for.
+struct StatementStats {
+    std::string statement;  // the statement text, shortened
+    double tokenize_ms = 0;
+    double parse_ms = 0;
+    double plan_ms = 0;     // choosing between index probes, bitmaps and zone-pruned scans
+    double execute_ms = 0;
+    double persist_ms = 0;  // loading and saving databases
+    uint64_t rows_scanned = 0;
+    uint64_t rows_output = 0;
+    uint64_t bytes_allocated = 0;  // only with ALLOCATIONS_COUNTED
+    uint64_t disk_bytes_read = 0;
+    uint64_t disk_bytes_written = 0;
+};
+
+// The statement being run, for tables and storage to add their counts to; null
+// while nothing is being measured.
+extern thread_local StatementStats* current_stats;
+
+using StatsClock = std::chrono::steady_clock;
+double elapsed_ms(StatsClock::time_point start);
+
+uint64_t file_bytes(const std::string& path);  // 0 when the file is missing
+
+// Counting allocations means replacing the global operator new and delete, so it
+// is opt-in: built only with MINIDB_COUNT_ALLOCATIONS defined, and even then a
+// thread counts only while it is measuring a statement. Without it SHOW STATS,
+// the --stats file and EXPLAIN ANALYZE leave allocated bytes out.
+#ifdef MINIDB_COUNT_ALLOCATIONS
+constexpr bool ALLOCATIONS_COUNTED = true;
+#else
+constexpr bool ALLOCATIONS_COUNTED = false;
+#endif
+
+// Bytes this thread requested from operator new while measuring; always 0 when
+// allocations are not counted.
+uint64_t allocated_bytes();
+
+void write_stats_json(std::ostream& out, const std::vector<StatementStats>& stats);
+
+#endif
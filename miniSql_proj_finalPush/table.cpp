@@ -1,17 +1,29 @@
 #include "table.hpp"
-
-#include "table.hpp"
+#include "arena.hpp"
+#include "stats.hpp"
+#include <algorithm>
 
 
-Table::Table(const Table& other) : name(other.name), schema(other.schema), rows(other.rows) {}
+Table::Table(const Table& other)
+    : name(other.name), schema(other.schema), rows(other.rows), isJoinedTable(other.isJoinedTable), primary_key(other.primary_key),
+      decimals(other.decimals), pk_index(other.pk_index), bitmap_indexes(other.bitmap_indexes), zones(other.zones), stats(other.stats) {}
 
 Table::Table(Table&& other) noexcept
-    : name(std::move(other.name)), schema(std::move(other.schema)), rows(std::move(other.rows)) {}
+    : name(std::move(other.name)), schema(std::move(other.schema)), rows(std::move(other.rows)),
+      isJoinedTable(other.isJoinedTable), primary_key(std::move(other.primary_key)), decimals(std::move(other.decimals)), pk_index(std::move(other.pk_index)),
+      bitmap_indexes(std::move(other.bitmap_indexes)), zones(std::move(other.zones)), stats(std::move(other.stats)) {}
 
 Table& Table::operator=(const Table& other) {
     name = other.name;
     schema = other.schema;
     rows = other.rows;
+    isJoinedTable = other.isJoinedTable;
+    primary_key = other.primary_key;
+    decimals = other.decimals;
+    pk_index = other.pk_index;
+    bitmap_indexes = other.bitmap_indexes;
+    zones = other.zones;
+    stats = other.stats;
     return *this;
 }
 
@@ -19,10 +31,17 @@ Table& Table::operator=(Table&& other) noexcept {
     name = std::move(other.name);
     schema = std::move(other.schema);
     rows = std::move(other.rows);
+    isJoinedTable = other.isJoinedTable;
+    primary_key = std::move(other.primary_key);
+    decimals = std::move(other.decimals);
+    pk_index = std::move(other.pk_index);
+    bitmap_indexes = std::move(other.bitmap_indexes);
+    zones = std::move(other.zones);
+    stats = std::move(other.stats);
     return *this;
 }
 
-void Table::append_row(Row row) {
+void Table::check_row_schema(Row& row) {
     if(row.schema.elements.size() != schema.elements.size()) {
         throw std::runtime_error("Row schema size mismatch");
     }
@@ -31,91 +50,612 @@ void Table::append_row(Row row) {
             throw std::runtime_error("Schema type mismatch");
         }
     }
-    rows.push_back(row);
 }
 
-Table Table::where(ExprPtr condition) {
-    Table result(name + "_filtered", schema);
-    for(auto& row : rows) {
-        if(condition->truthy(row)) {
-            result.rows.push_back(row);
+DecimalSpec Table::decimal_spec(size_t column) {
+    return column < decimals.size() ? decimals[column] : DecimalSpec();
+}
+
+CellData Table::coerce(size_t column, CellData value) {
+    return value.as(schema.elements[column].value, decimal_spec(column));
+}
+
+void Table::append_row(Row row) {
+    check_row_schema(row);
+    auto& all = rows.edit();
+    all.push_back(row);
+    size_t id = all.size() - 1;
+    if(!primary_key.empty() && !pk_index.edit().insert(all, pk_index->key_of(all, id), id)) {
+        std::string key = pk_index->key_of(all, id);
+        all.pop_back();
+        throw std::runtime_error("Duplicate primary key " + key + " in table " + name);
+    }
+    if(!bitmap_indexes->empty()) {
+        for(auto& index : bitmap_indexes.edit()) {
+            index.add(all[id].cells.elements[index.column].value, id);
+        }
+    }
+    zone_add(id);
+    stats_added(id);
+}
+
+// Appends a whole batch with one reservation. If any key is a duplicate (of the
+// table or of another row in the batch) none of the rows are added.
+void Table::append_rows(std::vector<Row> batch) {
+    for(auto& row : batch) check_row_schema(row);
+    auto& all = rows.edit();
+    size_t first = all.size();
+    // grow geometrically so a stream of small batches does not reallocate every time
+    if(all.capacity() < first + batch.size()) {
+        all.reserve(std::max(first + batch.size(), all.capacity() * 2));
+    }
+    for(auto& row : batch) all.push_back(std::move(row));
+
+    if(!primary_key.empty()) {
+        auto& index = pk_index.edit();
+        index.reserve(batch.size());
+        for(size_t id = first; id < all.size(); id++) {
+            if(index.insert(all, index.key_of(all, id), id)) continue;
+            std::string key = index.key_of(all, id);
+            for(size_t added = first; added < id; added++) index.erase(all, index.key_of(all, added));
+            all.erase(all.begin() + first, all.end());
+            throw std::runtime_error("Duplicate primary key " + key + " in table " + name);
+        }
+    }
+    for(size_t id = first; id < all.size(); id++) {
+        if(!bitmap_indexes->empty()) {
+            for(auto& index : bitmap_indexes.edit()) {
+                index.add(all[id].cells.elements[index.column].value, id);
+            }
+        }
+        zone_add(id);
+    }
+    stats_added(first);
+}
+
+void Table::rebuild_indexes() {
+    std::vector<BitmapIndex> rebuilt;
+    for(auto& declared : *bitmap_indexes) {
+        BitmapIndex index(declared.column);
+        for(size_t id = 0; id < rows->size(); id++) {
+            index.add((*rows)[id].cells.elements[index.column].value, id);
+        }
+        rebuilt.push_back(std::move(index));
+    }
+    bitmap_indexes = std::move(rebuilt);
+    pk_index = HashIndex();
+    if(primary_key.empty()) return;
+    HashIndex index(column_index(primary_key));
+    for(size_t id = 0; id < rows->size(); id++) {
+        if(!index.insert(*rows, index.key_of(*rows, id), id)) {
+            throw std::runtime_error("Duplicate primary key " + std::string(index.key_of(*rows, id)) + " in table " + name);
+        }
+    }
+    pk_index = std::move(index);
+}
+
+void Table::create_bitmap_index(std::string col) {
+    if(has_bitmap_index(col)) {
+        throw std::runtime_error("Bitmap index on " + name + "." + col + " already exists");
+    }
+    BitmapIndex index(column_index(col));
+    for(size_t id = 0; id < rows->size(); id++) {
+        index.add((*rows)[id].cells.elements[index.column].value, id);
+    }
+    bitmap_indexes.edit().push_back(index);
+}
+
+bool Table::has_bitmap_index(std::string col) {
+    for(auto& index : *bitmap_indexes) {
+        if(schema.elements[index.column].name == col) return true;
+    }
+    return false;
+}
+
+size_t Table::column_index(std::string col) {
+    for(size_t i = 0; i < schema.elements.size(); i++) {
+        if(schema.elements[i].name == col) return i;
+    }
+    throw std::runtime_error("Column not found: " + col);
+}
+
+size_t Table::block_count() {
+    return (rows->size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+void Table::zone_add(size_t id) {
+    size_t block = id / BLOCK_SIZE;
+    // zone maps are only kept while every earlier block has one
+    if(block > zones->size()) return;
+    auto& all = zones.edit();
+    if(block == all.size()) all.emplace_back(schema.size());
+    for(size_t c = 0; c < schema.size(); c++) {
+        all[block][c].add((*rows)[id].cells.elements[c].value, schema.elements[c].value);
+    }
+}
+
+void Table::rebuild_zones() {
+    zones = {};
+    for(size_t id = 0; id < rows->size(); id++) zone_add(id);
+}
+
+// `column <op> constant` terms of the condition that zone maps can rule out,
+// paired with the column's position.
+std::vector<std::pair<size_t, ColumnPredicate>> Table::zone_predicates(ExprPtr condition) {
+    std::vector<std::pair<size_t, ColumnPredicate>> result;
+    for(auto& term : conjuncts(condition)) {
+        auto pred = column_predicate(term);
+        if(!pred) continue;
+        for(size_t c = 0; c < schema.size(); c++) {
+            if(schema.elements[c].name != pred->column) continue;
+            // text against numbers is compared as strings, which the ranges don't describe
+            if((pred->value.type == DataType::TEXT) == (schema.elements[c].value == DataType::TEXT)) {
+                pred->value = pred->against(schema.elements[c].value);
+                result.push_back({c, *pred});
+            }
         }
     }
     return result;
 }
 
+bool Table::block_may_match(size_t block, std::vector<std::pair<size_t, ColumnPredicate>> preds) {
+    if(block >= zones->size()) return true;
+    size_t block_rows = std::min(BLOCK_SIZE, rows->size() - block * BLOCK_SIZE);
+    for(auto& [c, pred] : preds) {
+        const ZoneMap& zone = (*zones)[block][c];
+        if(zone.rows != block_rows) return true;  // rows added behind the zone map's back
+        if(!zone.may_match(pred.op, pred.value)) return false;
+    }
+    return true;
+}
+
+// Zone maps rule out most unsorted columns block by block; the rows confirm the rest.
+bool Table::sorted_on(size_t column) {
+    for(size_t block = 1; block < zones->size(); block++) {
+        const ZoneMap& before = (*zones)[block - 1][column];
+        const ZoneMap& zone = (*zones)[block][column];
+        if(before.ordered && zone.ordered && zone.rows && zone.min < before.max) return false;
+    }
+    for(size_t id = 1; id < rows->size(); id++) {
+        if((*rows)[id].cells.elements[column].value < (*rows)[id - 1].cells.elements[column].value) return false;
+    }
+    return true;
+}
+
+// Candidate rows for a condition containing `primary_key = constant` as one of its
+// AND-ed terms, found with a single index probe. nullopt means a scan is needed.
+std::optional<std::vector<size_t>> Table::pk_lookup(ExprPtr condition) {
+    if(primary_key.empty()) return std::nullopt;
+    bool key_is_text = schema[pk_index->column] == DataType::TEXT;
+    for(auto& term : conjuncts(condition)) {
+        auto pred = column_predicate(term);
+        if(!pred || pred->op != "=" || pred->column != primary_key) continue;
+        // text against numbers is compared as strings, which the index can't answer
+        if((pred->value.type == DataType::TEXT) != key_is_text) continue;
+        std::vector<size_t> result;
+        if(auto row = pk_index->find(*rows, pred->against(schema[pk_index->column]))) result.push_back(*row);
+        return result;
+    }
+    return std::nullopt;
+}
+
+// Rows that can satisfy the condition according to the bitmap and primary key
+// indexes: AND-ed terms intersect, OR-ed terms unite. nullopt when part of the
+// condition can only be answered by a scan.
+std::optional<Bitmap> Table::bitmap_lookup(ExprPtr condition) {
+    if(auto ops = and_operands(condition)) {
+        auto left = bitmap_lookup(ops->first);
+        auto right = bitmap_lookup(ops->second);
+        if(left && right) return *left & *right;
+        return left ? left : right;
+    }
+    if(auto ops = or_operands(condition)) {
+        auto left = bitmap_lookup(ops->first);
+        if(!left) return std::nullopt;
+        auto right = bitmap_lookup(ops->second);
+        if(!right) return std::nullopt;
+        return *left | *right;
+    }
+    auto pred = column_predicate(condition);
+    if(!pred || pred->op != "=") return std::nullopt;
+    bool value_is_text = pred->value.type == DataType::TEXT;
+    for(auto& index : *bitmap_indexes) {
+        auto& column = schema.elements[index.column];
+        if(column.name != pred->column) continue;
+        if(value_is_text != (column.value == DataType::TEXT)) return std::nullopt;
+        return index.lookup(pred->against(column.value));
+    }
+    if(!primary_key.empty() && pred->column == primary_key &&
+       value_is_text == (schema[pk_index->column] == DataType::TEXT)) {
+        Bitmap result;
+        if(auto row = pk_index->find(*rows, pred->against(schema[pk_index->column]))) result.add(*row);
+        return result;
+    }
+    return std::nullopt;
+}
+
+std::optional<double> Table::index_selectivity(ExprPtr condition) {
+    if(auto ops = and_operands(condition)) {
+        auto left = index_selectivity(ops->first);
+        auto right = index_selectivity(ops->second);
+        if(left && right) return *left * *right;
+        return left ? left : right;
+    }
+    if(auto ops = or_operands(condition)) {
+        auto left = index_selectivity(ops->first);
+        if(!left) return std::nullopt;
+        auto right = index_selectivity(ops->second);
+        if(!right) return std::nullopt;
+        return *left + *right - *left * *right;
+    }
+    auto pred = column_predicate(condition);
+    if(!pred || pred->op != "=") return std::nullopt;
+    bool value_is_text = pred->value.type == DataType::TEXT;
+    bool indexed = !primary_key.empty() && pred->column == primary_key;
+    for(auto& index : *bitmap_indexes) {
+        if(schema.elements[index.column].name == pred->column) indexed = true;
+    }
+    if(!indexed || value_is_text != (schema[column_index(pred->column)] == DataType::TEXT)) return std::nullopt;
+    return estimate_selectivity(condition, stats_lookup());
+}
+
+// Without statistics any index that answers the condition is used. With them, an
+// index is passed over when it would leave so many candidates that visiting them
+// costs more than scanning the table.
+bool Table::index_pays_off(ExprPtr condition) {
+    if(!stats->analyzed) return true;
+    auto fraction = index_selectivity(condition);
+    return !fraction || *fraction * INDEX_ROW_COST < SCAN_ROW_COST;
+}
+
+// Positions of the rows satisfying the condition, in table order.
+// Probes the indexes for candidates, else works out what zone maps let a scan skip.
+AccessPath Table::access_path(ExprPtr condition) {
+    AccessPath path;
+    if(auto candidates = pk_lookup(condition)) {
+        path.kind = AccessPath::Kind::PrimaryKey;
+        path.candidates = std::move(*candidates);
+        return path;
+    }
+    if(!bitmap_indexes->empty() && index_pays_off(condition)) {
+        if(auto bitmap = bitmap_lookup(condition)) {
+            path.kind = AccessPath::Kind::Bitmap;
+            path.candidates = bitmap->ids();
+            return path;
+        }
+    }
+    path.zone_preds = zone_predicates(condition);
+    return path;
+}
+
+std::vector<size_t> Table::matching_rows(ExprPtr condition) {
+    auto planning = StatsClock::now();
+    auto path = access_path(condition);
+    if(current_stats) current_stats->plan_ms += elapsed_ms(planning);
+    return matching_rows(condition, path);
+}
+
+std::vector<size_t> Table::matching_rows(ExprPtr condition, const AccessPath& path) {
+    std::vector<size_t> result;
+    size_t scanned = 0;
+    if(path.kind != AccessPath::Kind::Scan) {
+        for(auto id : path.candidates) {
+            if(condition->truthy((*rows)[id])) result.push_back(id);
+        }
+        scanned = path.candidates.size();
+    } else {
+        for(size_t block = 0; block < block_count(); block++) {
+            if(!path.zone_preds.empty() && !block_may_match(block, path.zone_preds)) continue;
+            size_t end = std::min(rows->size(), (block + 1) * BLOCK_SIZE);
+            for(size_t id = block * BLOCK_SIZE; id < end; id++) {
+                if(condition->truthy((*rows)[id])) result.push_back(id);
+            }
+            scanned += end - block * BLOCK_SIZE;
+        }
+    }
+    if(current_stats) current_stats->rows_scanned += scanned;
+    return result;
+}
+
+void Table::analyze() {
+    TableStats result;
+    result.analyzed = true;
+    result.version = stats->version + 1;
+    result.analyzed_rows = rows->size();
+    for(size_t c = 0; c < schema.size(); c++) {
+        std::vector<CellData> values;
+        values.reserve(rows->size());
+        for(auto& row : *rows) values.push_back(row.cells.elements[c].value);
+        result.columns.push_back(build_column_stats(std::move(values), TableStats::HISTOGRAM_BUCKETS));
+    }
+    stats = std::move(result);
+}
+
+// Inserted rows go into the distinct-value sketches right away; the histograms
+// wait until enough has changed to be worth a fresh ANALYZE.
+void Table::stats_added(size_t first) {
+    if(!stats->analyzed || first >= rows->size()) return;
+    auto& current = stats.edit();
+    for(size_t id = first; id < rows->size(); id++) {
+        for(size_t c = 0; c < current.columns.size(); c++) {
+            current.columns[c].add((*rows)[id].cells.elements[c].value);
+        }
+    }
+    stats_changed(rows->size() - first);
+}
+
+void Table::stats_changed(size_t count) {
+    if(!stats->analyzed || count == 0) return;
+    stats.edit().changes += count;
+    if(stats->stale()) analyze();
+}
+
+const ColumnStats* Table::column_stats(const std::string& col) {
+    if(!stats->analyzed) return nullptr;
+    for(size_t c = 0; c < schema.size() && c < stats->columns.size(); c++) {
+        if(schema.elements[c].name == col) return &stats->columns[c];
+    }
+    return nullptr;
+}
+
+ColumnStatsLookup Table::stats_lookup() {
+    return [this](const std::string& col) { return column_stats(col); };
+}
+
+double Table::estimate_rows(ExprPtr condition) {
+    return double(rows->size()) * estimate_selectivity(condition, stats_lookup());
+}
+
+Table Table::where(ExprPtr condition) {
+    Table result = gather({}, matching_rows(condition));
+    result.name = name + "_filtered";
+    return result;
+}
+
 void Table::delete_where(ExprPtr condition) {
-    rows.remove_if([&](Row& row) { return condition->truthy(row); });
+    delete_rows(matching_rows(condition));
 }
 
-void Table::update_where(ExprPtr condition, std::string col_name, ExprPtr new_value) {
-    for(auto& row : rows) {
-        if(condition->truthy(row)) {
-            row.cells[col_name] = new_value->eval(row);
+// Compacts in place. The rows after each gap move down, so the indexes only get
+// their positions renumbered and zones are recomputed from the first gap on.
+void Table::delete_rows(const std::vector<size_t>& ids) {
+    if(ids.empty()) return;
+    auto& all = rows.edit();
+    // index entries are found through the rows, so they go before the rows do
+    if(!primary_key.empty()) {
+        auto& keys = pk_index.edit();
+        for(auto id : ids) keys.erase(all, keys.key_of(all, id));
+    }
+    if(!bitmap_indexes->empty()) {
+        for(auto& index : bitmap_indexes.edit()) {
+            for(auto id : ids) index.remove(all[id].cells.elements[index.column].value, id);
+        }
+    }
+    size_t kept = ids.front(), next = 0;
+    for(size_t id = ids.front(); id < all.size(); id++) {
+        if(next < ids.size() && ids[next] == id) {
+            next++;
+            continue;
+        }
+        all[kept++] = std::move(all[id]);
+    }
+    all.erase(all.begin() + kept, all.end());
+    if(!primary_key.empty()) pk_index.edit().close_gaps(ids);
+    if(!bitmap_indexes->empty()) {
+        for(auto& index : bitmap_indexes.edit()) {
+            for(auto& [value, bitmap] : index.values) bitmap.close_gaps(ids);
+        }
+    }
+    close_zone_gaps(ids);
+    stats_changed(ids.size());
+}
+
+// After a delete, block b holds rows that used to be in a run of old blocks; the
+// union of those blocks' zones still bounds it, so the zones are merged instead
+// of recomputed from the rows. Blocks before the first gap are unchanged.
+void Table::close_zone_gaps(const std::vector<size_t>& ids) {
+    size_t first_block = ids.front() / BLOCK_SIZE;
+    if(first_block >= zones->size()) return;
+    std::vector<std::vector<ZoneMap>> old(zones->begin() + first_block, zones->end());
+    auto& all = zones.edit();
+    all.resize(first_block);
+    // where the row now at `id` used to be: after every removed id whose position
+    // less its rank is at most `id`
+    auto old_id = [&](size_t id) {
+        size_t lo = 0, hi = ids.size();
+        while(lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if(ids[mid] - mid <= id) lo = mid + 1;
+            else hi = mid;
         }
+        return id + lo;
+    };
+    for(size_t block = first_block; block < block_count(); block++) {
+        size_t block_rows = std::min(BLOCK_SIZE, rows->size() - block * BLOCK_SIZE);
+        size_t from = old_id(block * BLOCK_SIZE) / BLOCK_SIZE - first_block;
+        size_t to = old_id(block * BLOCK_SIZE + block_rows - 1) / BLOCK_SIZE - first_block;
+        if(to >= old.size()) break;  // zones are only kept while every earlier block has one
+        std::vector<ZoneMap> zone = old[from];
+        bool complete = true;  // a zone that missed some of its rows bounds nothing
+        for(size_t b = from; b <= to; b++) {
+            size_t old_rows = std::min(BLOCK_SIZE, rows->size() + ids.size() - (first_block + b) * BLOCK_SIZE);
+            for(size_t c = 0; c < zone.size(); c++) {
+                if(b > from) zone[c].merge(old[b][c]);
+                if(old[b][c].rows != old_rows) complete = false;
+            }
+        }
+        for(auto& column : zone) column.rows = complete ? block_rows : 0;
+        all.push_back(std::move(zone));
     }
 }
 
+void Table::update_where(ExprPtr condition, std::string col_name, ExprPtr new_value) {
+    NamedVector<ExprPtr> values;
+    values[col_name] = new_value;
+    update_where(condition, values);
+}
+
 // table.cpp
 void Table::update_where(ExprPtr condition, NamedVector<ExprPtr> values) {
-    for (auto& row : rows) {
-        if (condition->truthy(row)) {
+    update_rows(matching_rows(condition), values);
+}
+
+// Statement-atomic: every new row is computed before any is stored, and a
+// primary key rewrite is checked against the whole new key set, so a failing
+// UPDATE leaves the table as it was and SET id = id + 1 works in any row order.
+void Table::update_rows(const std::vector<size_t>& ids, NamedVector<ExprPtr> values) {
+    bool rekey = false;
+    for (auto& value : values.elements) {
+        if (!primary_key.empty() && value.name == primary_key) rekey = true;
+    }
+    if (ids.empty()) return;
+    std::vector<std::pair<size_t, ExprPtr>> assignments;
+    for (auto& value : values.elements) {
+        size_t c = column_index(value.name);
+        assignments.push_back({c, column_value(value.value, schema.elements[c].value)});
+    }
+    std::vector<Row> updated;
+    updated.reserve(ids.size());
+    for (auto id : ids) {
+        Row row = (*rows)[id];
+        for (auto& [c, value] : assignments) {
+            row.cells.elements[c].value = coerce(c, value->eval(row));
+        }
+        updated.push_back(std::move(row));
+    }
+    auto& all = rows.edit();
+    // after the swaps `updated` holds the old rows
+    auto swap_rows = [&] {
+        for (size_t i = 0; i < ids.size(); i++) std::swap(all[ids[i]], updated[i]);
+    };
+    if (rekey) {
+        auto& keys = pk_index.edit();
+        for (auto id : ids) keys.erase(all, keys.key_of(all, id));
+        swap_rows();
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (keys.insert(all, keys.key_of(all, ids[i]), ids[i])) continue;
+            std::string duplicate = keys.key_of(all, ids[i]);
+            for (size_t j = 0; j < i; j++) keys.erase(all, keys.key_of(all, ids[j]));
+            swap_rows();
+            for (auto id : ids) keys.insert(all, keys.key_of(all, id), id);
+            throw std::runtime_error("Duplicate primary key " + duplicate + " in table " + name);
+        }
+    } else {
+        swap_rows();
+    }
+    auto& bitmaps = bitmap_indexes.edit();
+    auto& blocks = zones.edit();
+    for (size_t i = 0; i < ids.size(); i++) {
+        size_t id = ids[i];
+        const Row& row = all[id];
+        for (auto& index : bitmaps) {
+            index.remove(updated[i].cells.elements[index.column].value, id);
+            index.add(row.cells.elements[index.column].value, id);
+        }
+        // zones only ever widen on update; deletes rebuild them exactly
+        size_t block = id / BLOCK_SIZE;
+        if (block < blocks.size()) {
+            for (size_t c = 0; c < schema.size(); c++) {
+                blocks[block][c].include(row.cells.elements[c].value, schema.elements[c].value);
+            }
+        }
+        if (stats->analyzed) {
             for (auto& value : values.elements) {
-                row.cells[value.name] = value.value->eval(row);
+                size_t c = column_index(value.name);
+                stats.edit().columns[c].add(row.cells.elements[c].value);
             }
         }
     }
+    stats_changed(ids.size());
 }
 
 Table Table::select(std::vector<std::string> cols) {
-    Schema new_schema;
+    return gather(cols);
+}
+
+// Filters pass row positions along and projections happen here, so only the
+// surviving cells of the wanted columns are ever copied.
+Table Table::gather(std::vector<std::string> cols, std::optional<std::vector<size_t>> ids) {
+    Schema new_schema = cols.empty() ? schema : Schema();
     for(auto& col : cols) {
-        new_schema[col] = schema[col];
+        new_schema[col] = schema.elements[column_index(col)].value;
+    }
+    std::vector<size_t> positions;
+    for(auto& column : new_schema.elements) positions.push_back(column_index(column.name));
+    bool all_columns = positions.size() == schema.size();
+    for(size_t c = 0; all_columns && c < positions.size(); c++) all_columns = positions[c] == c;
+
+    Table result(name + "_projected", new_schema, isJoinedTable);
+    if(all_columns && (!ids || ids->size() == rows->size())) {
+        result.rows = rows;
+        return result;
     }
-    
-    Table result(name + "_projected", new_schema);
-    for(auto& row : rows) {
+    size_t count = ids ? ids->size() : rows->size();
+    auto& gathered = result.rows.edit();
+    gathered.reserve(count);
+    for(size_t i = 0; i < count; i++) {
+        const Row& row = (*rows)[ids ? (*ids)[i] : i];
+        if(all_columns) {
+            gathered.push_back(row);
+            continue;
+        }
         Row new_row(new_schema);
-        for(auto& col : cols) {
-            new_row.cells[col] = row.cells[col];
+        for(size_t c = 0; c < positions.size(); c++) {
+            new_row.cells.elements[c].value = row.cells.elements[positions[c]].value;
         }
-        result.rows.push_back(new_row);
+        gathered.push_back(std::move(new_row));
     }
     return result;
 }
 
 Table Table::join(Table& other) {
-    Schema result_schema;
-    
-    // Handle left table columns
-    for(const auto& elem : schema.elements) {
-        std::string prefix = isJoinedTable ? "" : (name + ".");
-        result_schema[prefix + elem.name] = elem.value;
-    }
-    
-    // Handle right table columns
-    for(const auto& elem : other.schema.elements) {
-        std::string prefix = other.isJoinedTable ? "" : (other.name + ".");
-        result_schema[prefix + elem.name] = elem.value;
-    }
-    
-    Table result(name + "_" + other.name, result_schema, true);  // Mark as joined
-    
-    for(auto& row1 : rows) {
-        for(auto& row2 : other.rows) {
-            Row combined_row(result_schema);
-            // Copy data using the same prefixing logic
-            for(const auto& elem : schema.elements) {
-                std::string prefix = isJoinedTable ? "" : (name + ".");
-                combined_row[prefix + elem.name] = row1[elem.name];
-            }
-            for(const auto& elem : other.schema.elements) {
-                std::string prefix = other.isJoinedTable ? "" : (other.name + ".");
-                combined_row[prefix + elem.name] = row2[elem.name];
-            }
-            result.rows.push_back(combined_row);
-        }
+    JoinBuilder joined(*this, other);
+    joined.result.rows.edit().reserve(rows->size() * other.rows->size());
+    for(size_t i = 0; i < rows->size(); i++) {
+        for(size_t j = 0; j < other.rows->size(); j++) joined.add(i, j);
+    }
+    return std::move(joined.result);
+}
+
+Table Table::join(Table& other, std::span<const std::pair<size_t, size_t>> pairs) {
+    JoinBuilder joined(*this, other);
+    joined.result.rows.edit().reserve(pairs.size());
+    for(auto [i, j] : pairs) joined.add(i, j);
+    return std::move(joined.result);
+}
+
+static Schema joined_schema(const Table& left, const Table& right) {
+    Schema result;
+    for(const auto& elem : left.schema.elements) {
+        result[(left.isJoinedTable ? "" : left.name + ".") + elem.name] = elem.value;
+    }
+    for(const auto& elem : right.schema.elements) {
+        result[(right.isJoinedTable ? "" : right.name + ".") + elem.name] = elem.value;
     }
-    
     return result;
 }
+
+JoinBuilder::JoinBuilder(Table& left, Table& right)
+    : result(left.name + "_" + right.name, joined_schema(left, right), true), left(left), right(right) {
+    // the left row's cells come first, then the right row's, unless a name repeats
+    // and the right one overwrites it
+    for(const auto& elem : left.schema.elements) {
+        left_at.push_back(result.column_index((left.isJoinedTable ? "" : left.name + ".") + elem.name));
+    }
+    for(const auto& elem : right.schema.elements) {
+        right_at.push_back(result.column_index((right.isJoinedTable ? "" : right.name + ".") + elem.name));
+    }
+}
+
+void JoinBuilder::add(size_t left_row, size_t right_row) {
+    const Row& row1 = (*left.rows)[left_row];
+    const Row& row2 = (*right.rows)[right_row];
+    Row combined_row(result.schema);
+    for(size_t c = 0; c < left_at.size(); c++) {
+        combined_row.cells.elements[left_at[c]].value = row1.cells.elements[c].value;
+    }
+    for(size_t c = 0; c < right_at.size(); c++) {
+        combined_row.cells.elements[right_at[c]].value = row2.cells.elements[c].value;
+    }
+    result.rows.edit().push_back(std::move(combined_row));
+}
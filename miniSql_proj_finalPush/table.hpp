@@ -4,14 +4,40 @@
 
 #include "row.hpp"
 #include "expr.hpp"
-#include <list>
+#include "hash_index.hpp"
+#include "zone_map.hpp"
+#include "bitmap.hpp"
+#include "copy_on_write.hpp"
+#include "table_stats.hpp"
+#include <span>
+#include <vector>
+
+// How matching_rows reaches the rows a condition can match.
+struct AccessPath {
+    enum class Kind { PrimaryKey, Bitmap, Scan };
+    Kind kind = Kind::Scan;
+    std::vector<size_t> candidates;  // rows to check, for the index kinds
+    std::vector<std::pair<size_t, ColumnPredicate>> zone_preds;  // for scans: ranges that can skip blocks
+};
 
 class Table {
 public:
     std::string name;
     Schema schema;
-    std::list<Row> rows;
-    bool isJoinedTable;
+    // Rows and indexes are shared between copies of a table (query results, output
+    // tables) until one of the copies changes them.
+    CopyOnWrite<std::vector<Row>> rows;
+    bool isJoinedTable = false;
+    std::string primary_key;  // empty when the table has none
+    std::vector<DecimalSpec> decimals;  // per column; only read for DECIMAL columns
+    CopyOnWrite<HashIndex> pk_index;
+    CopyOnWrite<std::vector<BitmapIndex>> bitmap_indexes;
+
+    // Rows are grouped into fixed-size blocks by position; zones[block][column]
+    // summarises each block for scan skipping.
+    static constexpr size_t BLOCK_SIZE = 1024;
+    CopyOnWrite<std::vector<std::vector<ZoneMap>>> zones;
+    CopyOnWrite<TableStats> stats;  // from ANALYZE; not analyzed until then
     
     Table(std::string name, Schema schema, bool isJoined = false)
             : name(std::move(name)), schema(std::move(schema)), isJoinedTable(isJoined) {}
@@ -25,14 +51,65 @@ public:
     Table& operator=(Table&& other) noexcept;
     
     void append_row(Row row);
+    void append_rows(std::vector<Row> batch);  // all or nothing
+    void check_row_schema(Row& row);
+    DecimalSpec decimal_spec(size_t column);
+    CellData coerce(size_t column, CellData value);  // `value` as the column stores it
+    void rebuild_indexes();
+    void create_bitmap_index(std::string col);
+    bool has_bitmap_index(std::string col);
+    size_t column_index(std::string col);
+    size_t block_count();
+    void zone_add(size_t id);
+    void rebuild_zones();
+    void close_zone_gaps(const std::vector<size_t>& ids);  // zones after deleting the rows at `ids`
+    std::vector<std::pair<size_t, ColumnPredicate>> zone_predicates(ExprPtr condition);
+    bool block_may_match(size_t block, std::vector<std::pair<size_t, ColumnPredicate>> preds);
+    bool sorted_on(size_t column);  // values never decrease in row order
+    std::optional<std::vector<size_t>> pk_lookup(ExprPtr condition);
+    std::optional<Bitmap> bitmap_lookup(ExprPtr condition);
+    std::optional<double> index_selectivity(ExprPtr condition);  // of the part bitmap_lookup answers
+    bool index_pays_off(ExprPtr condition);
+    AccessPath access_path(ExprPtr condition);
+    std::vector<size_t> matching_rows(ExprPtr condition);
+    std::vector<size_t> matching_rows(ExprPtr condition, const AccessPath& path);
+    void analyze();
+    void stats_added(size_t first);  // rows from `first` on are new
+    void stats_changed(size_t count);
+    const ColumnStats* column_stats(const std::string& col);  // null before ANALYZE
+    ColumnStatsLookup stats_lookup();
+    double estimate_rows(ExprPtr condition);
     Table where(ExprPtr condition);
     void delete_where(ExprPtr condition);
+    void delete_rows(const std::vector<size_t>& ids);  // ids in table order
     void update_where(ExprPtr condition, std::string col_name, ExprPtr new_value);
     // table.hpp
     void update_where(ExprPtr condition, NamedVector<ExprPtr> values);
+    void update_rows(const std::vector<size_t>& ids, NamedVector<ExprPtr> values);
     Table select(std::vector<std::string> cols);
+    // Copies only `cols` (every column when empty) of the rows at `ids` (every row
+    // when nullopt; otherwise distinct positions in table order). Rows are shared
+    // instead of copied when nothing is left out.
+    Table gather(std::vector<std::string> cols, std::optional<std::vector<size_t>> ids = std::nullopt);
     // table.hpp
     Table join(Table& other);
+    // only the given (row, other's row) pairings, in that order
+    Table join(Table& other, std::span<const std::pair<size_t, size_t>> pairs);
+};
+
+// The join of two tables built one pairing at a time, for joins that find their
+// matches as they go. Columns are prefixed with their table's name as in Table::join.
+class JoinBuilder {
+public:
+    Table result;
+
+    JoinBuilder(Table& left, Table& right);
+    void add(size_t left_row, size_t right_row);
+
+private:
+    Table& left;
+    Table& right;
+    std::vector<size_t> left_at, right_at;  // where each input column goes in the result
 };
 #endif
 
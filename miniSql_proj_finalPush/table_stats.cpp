@@ -0,0 +1,150 @@
+#include "table_stats.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+
+void HyperLogLog::add(const CellData& value) {
+    uint64_t h = mixed_hash(value);
+    size_t index = h >> (64 - PRECISION);
+    uint64_t rest = (h << PRECISION) | (uint64_t(1) << (PRECISION - 1));  // caps the run length
+    uint8_t rank = static_cast<uint8_t>(std::countl_zero(rest) + 1);
+    registers[index] = std::max(registers[index], rank);
+}
+
+double HyperLogLog::estimate() const {
+    double m = double(registers.size());
+    double sum = 0;
+    size_t zeros = 0;
+    for (auto r : registers) {
+        sum += std::ldexp(1.0, -r);
+        if (r == 0) zeros++;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    // few distinct values leave registers empty; counting those is more accurate there
+    if (estimate <= 2.5 * m && zeros) estimate = m * std::log(m / double(zeros));
+    return estimate;
+}
+
+double ColumnStats::distinct_values() const {
+    return std::max(1.0, distinct.estimate());
+}
+
+double ColumnStats::equal_fraction(const CellData& value) const {
+    if (has_range && (value < min || value > max)) return 0;
+    if (bounds.empty()) return 1 / distinct_values();
+    size_t spanned = std::count(bounds.begin(), bounds.end(), value);
+    if (spanned > 1) return double(spanned) / double(bounds.size());
+    return 1 / distinct_values();
+}
+
+double ColumnStats::below_fraction(const CellData& value, bool inclusive) const {
+    if (bounds.empty()) return 1.0 / 3;
+    double buckets = 0;
+    for (size_t i = 0; i < bounds.size(); i++) {
+        const CellData& low = i ? bounds[i - 1] : min;
+        const CellData& high = bounds[i];
+        if (inclusive ? high <= value : high < value) {
+            buckets++;
+            continue;
+        }
+        // the value falls inside this bucket: interpolate numbers, split text evenly
+        if (low < value) {
+            bool numeric = value.type != DataType::TEXT && high.type != DataType::TEXT;
+            double width = numeric ? double(high) - double(low) : 0;
+            buckets += width > 0 ? std::clamp((double(value) - double(low)) / width, 0.0, 1.0) : 0.5;
+        }
+        break;
+    }
+    return buckets / double(bounds.size());
+}
+
+void ColumnStats::add(const CellData& value) {
+    distinct.add(value);
+    if (!has_range || value < min) min = value;
+    if (!has_range || value > max) max = value;
+    has_range = true;
+}
+
+ColumnStats build_column_stats(std::vector<CellData> values, size_t buckets) {
+    ColumnStats stats;
+    for (auto& value : values) stats.distinct.add(value);
+    if (values.empty()) return stats;
+    std::sort(values.begin(), values.end(), [](const CellData& a, const CellData& b) { return a < b; });
+    stats.has_range = true;
+    stats.min = values.front();
+    stats.max = values.back();
+    buckets = std::min(buckets, values.size());
+    for (size_t i = 1; i <= buckets; i++) {
+        stats.bounds.push_back(values[i * values.size() / buckets - 1]);
+    }
+    return stats;
+}
+
+bool TableStats::stale() const {
+    double limit = std::max(double(REFRESH_MIN_CHANGES), REFRESH_FRACTION * double(analyzed_rows));
+    return analyzed && double(changes) > limit;
+}
+
+static double selectivity(ExprPtr condition, const ColumnStatsLookup& stats) {
+    if (auto ops = and_operands(condition)) {
+        return selectivity(ops->first, stats) * selectivity(ops->second, stats);
+    }
+    if (auto ops = or_operands(condition)) {
+        double left = selectivity(ops->first, stats);
+        double right = selectivity(ops->second, stats);
+        return left + right - left * right;
+    }
+    if (auto pred = column_predicate(condition)) {
+        const ColumnStats* column = stats(pred->column);
+        if (pred->op == "=") return column ? column->equal_fraction(pred->value) : 0.1;
+        if (pred->op == "<>") return column ? 1 - column->equal_fraction(pred->value) : 0.9;
+        if (!column) return 1.0 / 3;
+        if (pred->op == "<") return column->below_fraction(pred->value, false);
+        if (pred->op == "<=") return column->below_fraction(pred->value, true);
+        if (pred->op == ">") return 1 - column->below_fraction(pred->value, true);
+        return 1 - column->below_fraction(pred->value, false);
+    }
+    if (auto in = dynamic_cast<InList*>(condition.get()); in && dynamic_cast<ColRef*>(in->operand.get())) {
+        const ColumnStats* column = stats(in->operand->str());
+        double fraction = 0;
+        for (auto& value : in->values) fraction += column ? column->equal_fraction(value) : 0.1;
+        return fraction;
+    }
+    if (auto columns = column_equality(condition)) {
+        // each value of the side with more of them matches one value of the other
+        double distinct = 0;
+        for (auto& name : {columns->first, columns->second}) {
+            if (auto column = stats(name)) distinct = std::max(distinct, column->distinct_values());
+        }
+        return distinct ? 1 / distinct : 0.1;
+    }
+    return 0.5;
+}
+
+double estimate_selectivity(ExprPtr condition, const ColumnStatsLookup& stats) {
+    if (condition.get() == nullptr) return 1;  // ExprPtr overloads !, so test the pointer itself
+    return std::clamp(selectivity(condition, stats), 0.0, 1.0);
+}
+
+ExprPtr order_conjuncts(ExprPtr condition, const ColumnStatsLookup& stats) {
+    if (condition.get() == nullptr) return condition;
+    auto terms = conjuncts(condition);
+    if (terms.size() < 2) return condition;
+    bool covered = false;
+    ColumnStatsLookup noting = [&](const std::string& name) {
+        auto column = stats(name);
+        if (column) covered = true;
+        return column;
+    };
+    std::vector<double> selectivities;
+    for (auto& term : terms) selectivities.push_back(estimate_selectivity(term, noting));
+    if (!covered) return condition;
+    std::vector<size_t> order(terms.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return selectivities[a] < selectivities[b]; });
+    if (std::is_sorted(order.begin(), order.end())) return condition;
+    std::vector<ExprPtr> ordered;
+    for (auto i : order) ordered.push_back(terms[i]);
+    return conjunction(ordered);
+}
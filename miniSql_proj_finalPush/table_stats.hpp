@@ -0,0 +1,71 @@
+#ifndef TABLE_STATS_H
+#define TABLE_STATS_H
+
+#include "celldata.hpp"
+#include "expr.hpp"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Distinct-value estimate in a fixed 1 KiB: each register keeps the longest run
+// of leading zero bits seen among the hashes routed to it.
+class HyperLogLog {
+public:
+    static constexpr int PRECISION = 10;  // 2^10 registers, about 3% standard error
+    std::vector<uint8_t> registers = std::vector<uint8_t>(size_t(1) << PRECISION);
+
+    void add(const CellData& value);
+    double estimate() const;
+};
+
+// What ANALYZE learned about one column.
+struct ColumnStats {
+    HyperLogLog distinct;
+    bool has_range = false;  // min and max are set once there was a value
+    CellData min, max;
+    // Equi-depth histogram: the largest value of each bucket, every bucket holding
+    // the same number of rows. A value spanning several bounds is a frequent one.
+    std::vector<CellData> bounds;
+
+    double distinct_values() const;
+    double equal_fraction(const CellData& value) const;                  // of rows = value
+    double below_fraction(const CellData& value, bool inclusive) const;  // of rows < (or <=) value
+    void add(const CellData& value);  // a row inserted since ANALYZE: sketch and range only
+};
+
+ColumnStats build_column_stats(std::vector<CellData> values, size_t buckets);
+
+struct TableStats {
+    static constexpr size_t HISTOGRAM_BUCKETS = 64;
+    // Rows inserted, updated or deleted since ANALYZE after which the histograms are
+    // rebuilt; inserts keep the distinct-value sketches current in between.
+    static constexpr size_t REFRESH_MIN_CHANGES = 100;
+    static constexpr double REFRESH_FRACTION = 0.2;
+
+    bool analyzed = false;
+    uint64_t version = 0;  // counts the ANALYZE runs, automatic ones included
+    uint64_t analyzed_rows = 0;
+    uint64_t changes = 0;
+    std::vector<ColumnStats> columns;  // by column position
+
+    bool stale() const;
+};
+
+// Relative costs for choosing access paths: reading the next row of a scan is the
+// unit, a row fetched from an index's candidate list costs more as it is visited
+// out of the scan's order.
+constexpr double SCAN_ROW_COST = 1.0;
+constexpr double INDEX_ROW_COST = 2.0;
+
+// Statistics of a column by the name a condition uses for it; null when unknown.
+using ColumnStatsLookup = std::function<const ColumnStats*(const std::string&)>;
+
+// Fraction of rows expected to satisfy `condition`. Terms without statistics get
+// fixed guesses: 1/10 for equality and for each IN value, 1/3 for ranges and 1/2
+// for anything else.
+double estimate_selectivity(ExprPtr condition, const ColumnStatsLookup& stats);
+// The AND-ed terms rebuilt with the most selective first, so evaluation stops
+// early on most rows. Unchanged unless statistics cover at least one term.
+ExprPtr order_conjuncts(ExprPtr condition, const ColumnStatsLookup& stats);
+
+#endif
@@ -3,6 +3,8 @@
 #include <sstream>
 #include <filesystem>
 #include "sql_handle.hpp"
+#include "csv_manip.hpp"
+#include "index_file.hpp"
 #include "test2.hpp"
 #include <iostream>
 
@@ -138,6 +140,833 @@ void run_tests_with_main() {
         assert(output12.find("'Alice','Physics',92.00") != std::string::npos);
         assert(output12.find("'Bob','Math',78.50") != std::string::npos);
 
+        std::cout << "Test 13: PRIMARY KEY uniqueness and lookups...\n";
+        write_test_file("test13.sql", R"(
+            USE DATABASE test_db;
+            CREATE TABLE accounts (
+                id INTEGER PRIMARY KEY,
+                owner TEXT
+            );
+            INSERT INTO accounts VALUES (1, 'Alice');
+            INSERT INTO accounts VALUES (2, 'Bob');
+            UPDATE accounts SET owner = 'Robert' WHERE id = 2;
+            DELETE FROM accounts WHERE id = 1;
+            INSERT INTO accounts VALUES (1, 'Carol');
+            SELECT * FROM accounts WHERE id = 2;
+            SELECT owner FROM accounts WHERE 1 = id;
+        )");
+
+        run_main_with_files("test13.sql", "test13_output.txt");
+        std::string output13 = read_file("test13_output.txt");
+        assert(output13.find("id,owner\n2,'Robert'\n") != std::string::npos);
+        assert(output13.find("owner\n'Carol'\n") != std::string::npos);
+
+        write_test_file("test13.sql", R"(
+            USE DATABASE test_db;
+            INSERT INTO accounts VALUES (2, 'Duplicate');
+        )");
+        char* dup_args[] = {
+            const_cast<char*>("program_name"),
+            const_cast<char*>("test13.sql"),
+            const_cast<char*>("test13_output.txt"),
+            nullptr
+        };
+        assert(main(3, dup_args) != 0);
+
+        // rekeying checks the whole new key set, so a shift by one succeeds in
+        // any row order and a collision leaves every row untouched
+        write_test_file("test13.sql", R"(
+            USE DATABASE test_db;
+            CREATE TABLE rekeyed (id INTEGER PRIMARY KEY, memo TEXT);
+            INSERT INTO rekeyed VALUES (1, 'a');
+            INSERT INTO rekeyed VALUES (2, 'b');
+            INSERT INTO rekeyed VALUES (3, 'c');
+            UPDATE rekeyed SET id = id + 1;
+            SELECT * FROM rekeyed;
+        )");
+        run_main_with_files("test13.sql", "test13_output.txt");
+        assert(read_file("test13_output.txt").find("id,memo\n2,'a'\n3,'b'\n4,'c'\n") != std::string::npos);
+        write_test_file("test13.sql", R"(
+            USE DATABASE test_db;
+            UPDATE rekeyed SET id = 9, memo = 'lost' WHERE id > 2;
+        )");
+        assert(main(3, dup_args) != 0);
+        write_test_file("test13.sql", R"(
+            USE DATABASE test_db;
+            SELECT * FROM rekeyed;
+            SELECT memo FROM rekeyed WHERE id = 4;
+        )");
+        run_main_with_files("test13.sql", "test13_output.txt");
+        output13 = read_file("test13_output.txt");
+        assert(output13.find("id,memo\n2,'a'\n3,'b'\n4,'c'\n---\nmemo\n'c'\n") != std::string::npos);
+
+        std::cout << "Test 14: Range scans across table blocks...\n";
+        {
+            std::string script = "USE DATABASE test_db;\nCREATE TABLE events (ts INTEGER, kind TEXT);\n";
+            for (int i = 0; i < 2100; i++) {
+                script += "INSERT INTO events VALUES (" + std::to_string(i) + ", 'k" + std::to_string(i % 3) + "');\n";
+            }
+            script += "SELECT * FROM events WHERE ts > 2097;\n";
+            script += "DELETE FROM events WHERE ts < 2000;\n";
+            script += "UPDATE events SET ts = 7 WHERE ts = 2099;\n";
+            script += "SELECT ts FROM events WHERE ts < 2001;\n";
+            write_test_file("test14.sql", script);
+        }
+        run_main_with_files("test14.sql", "test14_output.txt");
+        std::string output14 = read_file("test14_output.txt");
+        assert(output14.find("ts,kind\n2098,'k1'\n2099,'k2'\n---") != std::string::npos);
+        assert(output14.find("ts\n2000\n7\n---") != std::string::npos);
+        {
+            // deletes renumber the indexes in place instead of rebuilding them
+            SqlInterpreter interpreter;
+            std::string script = "USE DATABASE test_db; CREATE TABLE ticks (id INTEGER PRIMARY KEY, kind TEXT, v INTEGER);"
+                                 "CREATE BITMAP INDEX ON ticks (kind); INSERT INTO ticks VALUES ";
+            for (int i = 0; i < 2100; i++) {
+                script += (i ? ", (" : "(") + std::to_string(i) + ", 'k" + std::to_string(i % 3) + "', " + std::to_string(i) + ")";
+            }
+            interpreter.execute(script + "; DELETE FROM ticks WHERE kind = 'k1'; DELETE FROM ticks WHERE id = 3;");
+            auto& ticks = interpreter.current_db->get_table("ticks");
+            assert(ticks.rows->size() == 1399);
+            for (size_t id = 0; id < ticks.rows->size(); id++) {
+                assert(ticks.pk_index->find(*ticks.rows, (*ticks.rows)[id].cells.elements[0].value) == id);
+            }
+            interpreter.execute("SELECT id FROM ticks WHERE id < 7;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "id\n0\n2\n5\n6\n");
+            interpreter.execute("SELECT id FROM ticks WHERE kind = 'k2' AND id > 2090;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "id\n2093\n2096\n2099\n");
+            interpreter.execute("SELECT id FROM ticks WHERE v >= 2095;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "id\n2096\n2097\n2099\n");
+        }
+
+        std::cout << "Test 15: Bitmap indexes on categorical columns...\n";
+        write_test_file("test15.sql", R"(
+            USE DATABASE test_db;
+            CREATE TABLE staff (id INTEGER, major TEXT, dept TEXT);
+            CREATE BITMAP INDEX ON staff (major);
+            CREATE BITMAP INDEX ON staff (dept);
+            INSERT INTO staff VALUES (1, 'CS', 'Eng');
+            INSERT INTO staff VALUES (2, 'EE', 'Eng');
+            INSERT INTO staff VALUES (3, 'CS', 'Sci');
+            INSERT INTO staff VALUES (4, 'Math', 'Sci');
+            UPDATE staff SET major = 'CS' WHERE id = 4;
+            DELETE FROM staff WHERE id = 1;
+            SELECT id FROM staff WHERE major = 'CS' AND dept = 'Sci';
+            SELECT id FROM staff WHERE major = 'EE' OR dept = 'Sci';
+        )");
+        run_main_with_files("test15.sql", "test15_output.txt");
+        std::string output15 = read_file("test15_output.txt");
+        assert(output15.find("id\n3\n4\n---\nid\n2\n3\n4\n---") != std::string::npos);
+        {
+            // a container at the dense/sparse boundary stays dense while ids come and go
+            Bitmap::Container c;
+            for (size_t low = 0; low <= Bitmap::ARRAY_LIMIT; low++) c.add(uint16_t(low));
+            assert(c.dense());
+            c.remove(0);
+            c.add(0);
+            c.remove(0);
+            assert(c.dense());
+            for (size_t low = 1; c.cardinality >= Bitmap::SPARSE_LIMIT; low++) c.remove(uint16_t(low));
+            assert(!c.dense() && c.cardinality == Bitmap::SPARSE_LIMIT - 1 && c.contains(uint16_t(Bitmap::ARRAY_LIMIT)));
+        }
+
+        std::cout << "Test 16: Persisted indexes are rebuilt when stale...\n";
+        assert(file_exists("./dbs/test_db/accounts.idx"));
+        {
+            // edit the table file behind the index file's back
+            std::ofstream csv("./dbs/test_db/accounts.csv", std::ios::app);
+            csv << "5,Eve\n";
+        }
+        write_test_file("test16.sql", R"(
+            USE DATABASE test_db;
+            SELECT owner FROM accounts WHERE id = 5;
+            SELECT owner FROM accounts WHERE id = 2;
+        )");
+        run_main_with_files("test16.sql", "test16_output.txt");
+        std::string output16 = read_file("test16_output.txt");
+        assert(output16.find("owner\n'Eve'\n---\nowner\n'Robert'\n---") != std::string::npos);
+        {
+            // an index file pointing past the table's rows is refused, not adopted
+            SqlInterpreter interpreter;
+            interpreter.execute("USE DATABASE test_db;"
+                                "CREATE TABLE keyed4 (id INTEGER PRIMARY KEY); CREATE TABLE keyed3 (id INTEGER PRIMARY KEY);"
+                                "CREATE TABLE tagged4 (tag TEXT); CREATE BITMAP INDEX ON tagged4 (tag);"
+                                "CREATE TABLE tagged3 (tag TEXT); CREATE BITMAP INDEX ON tagged3 (tag);"
+                                "INSERT INTO keyed4 VALUES (1), (2), (3), (4); INSERT INTO keyed3 VALUES (1), (2), (3);"
+                                "INSERT INTO tagged4 VALUES ('a'), ('b'), ('a'), ('b'); INSERT INTO tagged3 VALUES ('a'), ('b'), ('a');");
+            IndexStamp stamp{1, 2, 4};
+            for (std::string name : {"keyed", "tagged"}) {
+                write_index_file(interpreter.current_db->get_table(name + "4"), "rows4_test.idx", stamp);
+                assert(read_index_file(interpreter.current_db->get_table(name + "4"), "rows4_test.idx", stamp));
+                assert(!read_index_file(interpreter.current_db->get_table(name + "3"), "rows4_test.idx", stamp));
+            }
+            // so is one whose slots hash other keys than the rows hold
+            write_index_file(interpreter.current_db->get_table("keyed4"), "rows4_test.idx", stamp);
+            interpreter.execute("UPDATE keyed4 SET id = 10 WHERE id = 1;");
+            assert(!read_index_file(interpreter.current_db->get_table("keyed4"), "rows4_test.idx", stamp));
+            interpreter.execute("SELECT id FROM keyed4 WHERE id = 10;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "id\n10\n");
+            std::filesystem::remove("rows4_test.idx");
+        }
+
+        std::cout << "Test 17: String literals keep underscores and spacing...\n";
+        write_test_file("test17.sql", R"(
+            USE DATABASE test_db;
+            CREATE TABLE notes (id INTEGER, body TEXT); -- trailing comment
+            INSERT INTO notes VALUES (1, 'snake_case  and spaces');
+            INSERT INTO notes VALUES (2, 'it''s');
+            SELECT body FROM notes WHERE id = 1;
+            SELECT id FROM notes WHERE body = 'it''s';
+        )");
+        run_main_with_files("test17.sql", "test17_output.txt");
+        std::string output17 = read_file("test17_output.txt");
+        assert(output17.find("body\n'snake_case  and spaces'\n---\nid\n2\n---") != std::string::npos);
+
+        // Test 18: Operator precedence, NOT, unary minus and the extra comparisons
+        std::cout << "Test 18: Expression precedence...\n";
+        write_test_file("test18.sql", R"(
+            USE DATABASE test_db;
+            CREATE TABLE vals (id INTEGER, a INTEGER, b INTEGER);
+            INSERT INTO vals VALUES (1, 5, 0);
+            INSERT INTO vals VALUES (2, 0, 4);
+            INSERT INTO vals VALUES (3, 0, 0);
+            INSERT INTO vals VALUES (4, 7, 7);
+            UPDATE vals SET a = -3 WHERE id = 2;
+            UPDATE vals SET b = -(1 + 1) WHERE id = 1;
+            SELECT id FROM vals WHERE a >= 5 OR b <= -2 AND a != 0;
+            SELECT id FROM vals WHERE NOT a = b AND -a < 4 AND b + 2 * 3 > 5;
+            SELECT id FROM vals WHERE (a < 0 OR a > 6) AND b <> 7;
+        )");
+        run_main_with_files("test18.sql", "test18_output.txt");
+        std::string output18 = read_file("test18_output.txt");
+        assert(output18.find("id\n1\n4\n---\nid\n2\n---\nid\n2\n---") != std::string::npos);
+
+        // Test 19: Statements run one at a time; results before a failure are kept
+        std::cout << "Test 19: Streaming script execution...\n";
+        write_test_file("test19.sql", R"(
+            USE DATABASE test_db;
+            CREATE TABLE logs (id INTEGER, msg TEXT);
+            INSERT INTO logs VALUES (1, 'a;b'); -- a comment; with a 'quote
+            INSERT INTO logs VALUES (2, 'x--y');
+            SELECT msg FROM logs WHERE id = 1;
+            SELECT msg FROM logs WHERE id = 2;
+            SELECT msg FROM missing_table;
+            SELECT msg FROM logs;
+        )");
+        char* stream_args[] = {
+            const_cast<char*>("program_name"),
+            const_cast<char*>("test19.sql"),
+            const_cast<char*>("test19_output.txt"),
+            nullptr
+        };
+        assert(main(3, stream_args) != 0);
+        std::string output19 = read_file("test19_output.txt");
+        assert(output19 == "msg\n'a;b'\n---\nmsg\n'x--y'\n---\n");
+
+        // Test 20: Prepared statements are parsed once and run with new bindings
+        std::cout << "Test 20: Prepared statements...\n";
+        {
+            SqlInterpreter interpreter;
+            interpreter.execute("USE DATABASE test_db; CREATE TABLE kv (k INTEGER PRIMARY KEY, v TEXT);");
+            auto insert = interpreter.prepare("INSERT INTO kv VALUES (?, ?)");
+            assert(insert->param_count() == 2);
+            for (int i = 0; i < 100; i++) {
+                insert->bind(0, CellData(i));
+                insert->bind(1, CellData("v" + std::to_string(i)));
+                interpreter.execute(*insert);
+            }
+
+            auto lookup = interpreter.prepare("SELECT v FROM kv WHERE k = ?;");
+            lookup->bind(0, CellData(41));
+            interpreter.execute(*lookup);
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "v\n'v41'\n");
+            lookup->bind(0, CellData(99));
+            interpreter.execute(*lookup);
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "v\n'v99'\n");
+
+            auto update = interpreter.prepare("UPDATE kv SET v = ? WHERE k >= ? AND k < ? + 2;");
+            assert(interpreter.tokens.empty());  // prepare() keeps no views into its argument
+            update->bind(0, CellData("hot"));
+            bool unbound_rejected = false;
+            try { interpreter.execute(*update); } catch (const std::runtime_error&) { unbound_rejected = true; }
+            assert(unbound_rejected);
+            update->bind(1, CellData(10));
+            update->bind(2, CellData(10));
+            interpreter.execute(*update);
+            interpreter.execute("SELECT k FROM kv WHERE v = 'hot';");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "k\n10\n11\n");
+            // the statement's arena is gone once execute() returns; its result is not in it
+            assert(statement_arena == nullptr && interpreter.tokens.empty());
+
+            // the plan is kept between executions and rebuilt once the schema changes
+            auto planned = lookup->plan;
+            lookup->bind(0, CellData(7));
+            interpreter.execute(*lookup);
+            assert(lookup->plan == planned);
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "v\n'v7'\n");
+            // and once the table's statistics are refreshed, here by inserts past the ANALYZE
+            interpreter.execute("ANALYZE kv;");
+            interpreter.execute(*lookup);
+            planned = lookup->plan;
+            for (int i = 100; i < 130; i++) {
+                insert->bind(0, CellData(i));
+                insert->bind(1, CellData("v" + std::to_string(i)));
+                interpreter.execute(*insert);
+            }
+            interpreter.execute(*lookup);
+            assert(lookup->plan == planned);
+            for (int i = 130; i < 201; i++) {
+                insert->bind(0, CellData(i));
+                insert->bind(1, CellData("v" + std::to_string(i)));
+                interpreter.execute(*insert);
+            }
+            interpreter.execute(*lookup);
+            assert(lookup->plan != planned);
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "v\n'v7'\n");
+            interpreter.execute("DROP TABLE kv; CREATE TABLE kv (v TEXT, k INTEGER); INSERT INTO kv VALUES ('new', 7);");
+            interpreter.execute(*lookup);
+            assert(lookup->plan != planned);
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "v\n'new'\n");
+        }
+
+        // Test 21: Multi-row VALUES convert to the column types and insert all or nothing
+        std::cout << "Test 21: Multi-row INSERT...\n";
+        write_test_file("test21.sql", R"(
+            USE DATABASE test_db;
+            CREATE TABLE batch (id INTEGER PRIMARY KEY, price FLOAT, label TEXT);
+            INSERT INTO batch VALUES (1, 2, 'a'), (2, 3.5, 'b'), (3, 4, 'c');
+            SELECT * FROM batch WHERE price > 2.5;
+            INSERT INTO batch VALUES (4, 1, 'd'), (1, 1, 'dup');
+        )");
+        char* batch_args[] = {
+            const_cast<char*>("program_name"),
+            const_cast<char*>("test21.sql"),
+            const_cast<char*>("test21_output.txt"),
+            nullptr
+        };
+        assert(main(3, batch_args) != 0);
+        std::string output21 = read_file("test21_output.txt");
+        assert(output21 == "id,price,label\n2,3.50,'b'\n3,4.00,'c'\n---\n");
+        write_test_file("test21.sql", R"(
+            USE DATABASE test_db;
+            SELECT id FROM batch;
+        )");
+        run_main_with_files("test21.sql", "test21_output.txt");
+        assert(read_file("test21_output.txt") == "id\n1\n2\n3\n---\n");
+
+        // Test 22: COPY exports and imports CSV, keeping floats exact and quoting text
+        std::cout << "Test 22: COPY FROM / TO...\n";
+        write_test_file("test22_import.csv", "price,id,label\n1.5,3,\"multi\nline\"\n");
+        write_test_file("test22.sql", R"(
+            USE DATABASE test_db;
+            CREATE TABLE src (id INTEGER, label TEXT, price FLOAT);
+            INSERT INTO src VALUES (1, 'plain', 0.125), (2, 'comma, "quote"', 2);
+            COPY src TO 'test22_export.csv';
+            CREATE TABLE dst (id INTEGER, label TEXT, price FLOAT);
+            COPY dst FROM 'test22_export.csv';
+            COPY dst FROM 'test22_import.csv';
+            SELECT id FROM dst WHERE price = 0.125;
+            SELECT label FROM dst WHERE id = 2;
+            SELECT id FROM dst WHERE price > 1;
+        )");
+        run_main_with_files("test22.sql", "test22_output.txt");
+        assert(read_file("test22_export.csv") == "id,label,price\n1,plain,0.125\n2,\"comma, \"\"quote\"\"\",2\n");
+        assert(read_file("test22_output.txt") ==
+               "id\n1\n---\nlabel\n'comma, \"quote\"'\n---\nid\n2\n3\n---\n");
+        // the table files keep text with separators intact too
+        write_test_file("test22.sql", R"(
+            USE DATABASE test_db;
+            SELECT label FROM dst WHERE id = 3;
+            SELECT label FROM src WHERE id = 2;
+        )");
+        run_main_with_files("test22.sql", "test22_output.txt");
+        assert(read_file("test22_output.txt") == "label\n'multi\nline'\n---\nlabel\n'comma, \"quote\"'\n---\n");
+        {
+            // errors name the physical line, counting the lines inside quoted fields
+            write_test_file("test22_import.csv", "id,label,price\n1,\"two\nlines\",1\n2,short\n");
+            Schema schema;
+            schema["id"] = DataType::INTEGER;
+            schema["label"] = DataType::TEXT;
+            schema["price"] = DataType::FLOAT;
+            Table target("target", schema);
+            std::string error;
+            try {
+                csv_copy_from(target, "test22_import.csv");
+            } catch (const std::runtime_error& e) {
+                error = e.what();
+            }
+            assert(error == "Expected 3 fields on line 4 of test22_import.csv");
+            write_test_file("test22_import.csv", "id,label,price\n1,\"two\nlines\",1\n2,x,abc\n");
+            try {
+                csv_copy_from(target, "test22_import.csv");
+            } catch (const std::runtime_error& e) {
+                error = e.what();
+            }
+            assert(error == "test22_import.csv:4: cannot convert 'abc' to FLOAT");
+            assert(target.rows->empty());
+        }
+
+        // Test 23: Numeric parsing and type inference
+        std::cout << "Test 23: Numeric parsing...\n";
+        assert(inferred_cell("12").type == DataType::INTEGER);
+        assert(inferred_cell(" -7 ").type == DataType::INTEGER);
+        assert(inferred_cell("1.5").type == DataType::FLOAT);
+        assert(inferred_cell("1e3").type == DataType::FLOAT);
+        assert(inferred_cell("99999999999").type == DataType::BIGINT);
+        assert(inferred_cell("12abc").type == DataType::TEXT);
+        assert(inferred_cell("nan").type == DataType::TEXT);
+        assert(int(CellData("42")) == 42);
+        write_test_file("test23.sql", R"(
+            USE DATABASE test_db;
+            CREATE TABLE nums (id INTEGER, f FLOAT, t TEXT);
+            INSERT INTO nums VALUES (1, 1e3, 'x1'), (2, 3000000000, '7');
+            SELECT id FROM nums WHERE f > 2000;
+            SELECT id FROM nums WHERE id = 2 AND t + 1 = 8;
+        )");
+        run_main_with_files("test23.sql", "test23_output.txt");
+        assert(read_file("test23_output.txt") == "id\n2\n---\nid\n2\n---\n");
+
+        // Test 24: BIGINT and DECIMAL columns with exact arithmetic
+        std::cout << "Test 24: BIGINT and DECIMAL...\n";
+        write_test_file("test24.sql", R"(
+            USE DATABASE test_db;
+            CREATE TABLE ledger (id BIGINT PRIMARY KEY, amount DECIMAL(10, 2), qty INTEGER);
+            INSERT INTO ledger VALUES (5000000000, 0.10, 3), (5000000001, 0.2, 1), (5000000002, 19.999, 2);
+            UPDATE ledger SET amount = amount * qty + 0.05 WHERE id = 5000000000;
+            SELECT * FROM ledger WHERE amount + 0.20 = 0.55;
+            SELECT id, amount FROM ledger WHERE amount >= 20;
+        )");
+        run_main_with_files("test24.sql", "test24_output.txt");
+        assert(read_file("test24_output.txt") ==
+               "id,amount,qty\n5000000000,0.35,3\n---\nid,amount\n5000000002,20.00\n---\n");
+        write_test_file("test24.sql", R"(
+            USE DATABASE test_db;
+            SELECT amount FROM ledger WHERE id = 5000000001;
+            INSERT INTO ledger VALUES (1, 123456789.00, 1);
+        )");
+        char* decimal_args[] = {
+            const_cast<char*>("program_name"),
+            const_cast<char*>("test24.sql"),
+            const_cast<char*>("test24_output.txt"),
+            nullptr
+        };
+        assert(main(3, decimal_args) != 0);
+        assert(read_file("test24_output.txt") == "amount\n0.20\n---\n");
+        {
+            // numbers written with a point are FLOAT, and exact only next to a DECIMAL
+            SqlInterpreter interpreter;
+            interpreter.execute("USE DATABASE test_db; SELECT qty FROM ledger WHERE 1.0 / 3 > 0.333 AND id = 5000000002;"
+                                "INSERT INTO ledger VALUES (7, 2.675, 1); UPDATE ledger SET amount = 1.005 WHERE id = 5000000002;"
+                                "SELECT id FROM ledger WHERE amount = 2.68 OR amount = 1.01;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "qty\n2\n");
+            assert(csv_dumps(interpreter.outputTables[1], false, true) == "id\n5000000002\n7\n");
+            bool threw = false;
+            try {
+                (void)int(CellData::bigint(5000000000));
+            } catch (const std::runtime_error&) {
+                threw = true;
+            }
+            assert(threw && int(CellData::bigint(-7)) == -7);
+        }
+
+        // Test 25: Query results share rows with their table until one side changes
+        std::cout << "Test 25: Copy-on-write results...\n";
+        {
+            SqlInterpreter interpreter;
+            interpreter.execute("USE DATABASE test_db; CREATE TABLE snap (id INTEGER PRIMARY KEY, v TEXT);"
+                                "INSERT INTO snap VALUES (1, 'a'), (2, 'b');");
+            auto& base = interpreter.current_db->get_table("snap");
+            interpreter.execute("SELECT * FROM snap; SELECT id, v FROM snap WHERE id > 0; SELECT v FROM snap;");
+            assert(interpreter.outputTables[0].rows.shares_with(base.rows));
+            assert(interpreter.outputTables[1].rows.shares_with(base.rows));
+            assert(!interpreter.outputTables[2].rows.shares_with(base.rows));
+
+            Table before = interpreter.outputTables[0];
+            interpreter.execute("UPDATE snap SET v = 'changed' WHERE id = 1; INSERT INTO snap VALUES (3, 'c');");
+            assert(!before.rows.shares_with(base.rows));
+            assert(csv_dumps(before, false, true) == "id,v\n1,'a'\n2,'b'\n");
+            assert(base.pk_index->find(*base.rows, CellData(3)).has_value());
+            assert(!before.pk_index->find(*before.rows, CellData(3)).has_value());
+            interpreter.execute("SELECT v FROM snap WHERE id = 1;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "v\n'changed'\n");
+        }
+
+        // Test 26: Filters hand row positions to the projection, which copies only what survives
+        std::cout << "Test 26: Late materialization...\n";
+        {
+            SqlInterpreter interpreter;
+            interpreter.execute("USE DATABASE test_db; CREATE TABLE wide (id INTEGER, a TEXT, b TEXT, c FLOAT, d INTEGER);"
+                                "INSERT INTO wide VALUES (1, 'x', 'y', 1.5, 10), (2, 'x', 'z', 2.5, 20), (3, 'w', 'z', 3.5, 30);");
+            auto& base = interpreter.current_db->get_table("wide");
+            interpreter.execute("SELECT d, id FROM wide WHERE b = 'z'; SELECT * FROM wide WHERE id > 0; SELECT * FROM wide WHERE a = 'x';");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "d,id\n20,2\n30,3\n");
+            assert(interpreter.outputTables[0].rows->at(0).cells.size() == 2);
+            assert(interpreter.outputTables[1].rows.shares_with(base.rows));
+            assert(csv_dumps(interpreter.outputTables[2], false, true) == "id,a,b,c,d\n1,'x','y',1.50,10\n2,'x','z',2.50,20\n");
+            bool unknown_rejected = false;
+            try { interpreter.execute("SELECT nope FROM wide WHERE id = 1;"); } catch (const std::runtime_error&) { unknown_rejected = true; }
+            assert(unknown_rejected);
+        }
+
+        // Test 27: Per-statement counters, SHOW STATS and the --stats file
+        std::cout << "Test 27: Statement statistics...\n";
+        {
+            SqlInterpreter interpreter;
+            interpreter.execute("USE DATABASE test_db; CREATE TABLE hits (id INTEGER PRIMARY KEY, n INTEGER);"
+                                "INSERT INTO hits VALUES (1, 5), (2, 6), (3, 7);");
+            interpreter.execute("SELECT id FROM hits WHERE n > 5; SELECT n FROM hits WHERE id = 3;");
+            auto& stats = interpreter.statement_stats;
+            assert(stats.size() == 5);
+            assert(stats[0].statement == "USE DATABASE test_db;" && stats[0].disk_bytes_read > 0);
+            assert(stats[3].statement == "SELECT id FROM hits WHERE n > 5;");
+            assert(stats[3].rows_scanned == 3 && stats[3].rows_output == 2);
+            assert(stats[4].rows_scanned == 1 && stats[4].rows_output == 1);
+            assert(ALLOCATIONS_COUNTED ? stats[3].bytes_allocated > 0 : stats[3].bytes_allocated == 0);
+            interpreter.execute("SHOW STATS;");
+            assert(interpreter.statement_stats.size() == 5);
+            auto shown = csv_dumps(interpreter.outputTables[0], false, true);
+            std::string counters = ALLOCATIONS_COUNTED ? "rows_output,bytes_allocated," : "rows_output,";
+            assert(shown.rfind("statement,tokenize_ms,parse_ms,plan_ms,execute_ms,persist_ms,rows_scanned," + counters +
+                               "disk_bytes_read,disk_bytes_written\n'USE DATABASE test_db;',", 0) == 0);
+        }
+        write_test_file("test27.sql", "USE DATABASE test_db;\nSELECT n FROM hits WHERE n = 6;\nSHOW STATS;\n");
+        char* stats_args[] = {
+            const_cast<char*>("program_name"),
+            const_cast<char*>("test27.sql"),
+            const_cast<char*>("test27_output.txt"),
+            const_cast<char*>("--stats"),
+            nullptr
+        };
+        assert(main(4, stats_args) == 0);
+        assert(read_file("test27_output.txt").find("'SELECT n FROM hits WHERE n = 6;',") != std::string::npos);
+        std::string stats_json = read_file("test27_output.txt.stats.json");
+        assert(stats_json.find("\"statement\": \"SELECT n FROM hits WHERE n = 6;\"") != std::string::npos);
+        assert(stats_json.find("\"rows_scanned\": 3, \"rows_output\": 1") != std::string::npos);
+
+        // Test 28: EXPLAIN shows the operator tree; ANALYZE runs it and adds actuals
+        std::cout << "Test 28: EXPLAIN and EXPLAIN ANALYZE...\n";
+        write_test_file("test28.sql", R"(
+            USE DATABASE test_db;
+            CREATE TABLE owners (id INTEGER PRIMARY KEY, name TEXT);
+            CREATE TABLE pets (owner INTEGER, kind TEXT);
+            INSERT INTO owners VALUES (1, 'Ann'), (2, 'Ben');
+            INSERT INTO pets VALUES (1, 'cat'), (2, 'dog'), (2, 'fish');
+            EXPLAIN SELECT name FROM owners WHERE id = 2;
+            EXPLAIN SELECT owners.name, pets.kind FROM owners INNER JOIN pets ON owners.id = pets.owner WHERE pets.kind <> 'dog';
+            EXPLAIN ANALYZE SELECT * FROM pets WHERE owner = 2;
+            EXPLAIN DELETE FROM pets WHERE kind = 'cat';
+            EXPLAIN ANALYZE UPDATE pets SET kind = 'bird' WHERE kind = 'fish';
+            SELECT kind FROM pets;
+        )");
+        run_main_with_files("test28.sql", "test28_output.txt");
+        std::string output28 = read_file("test28_output.txt");
+        assert(output28.find("plan\n'Project name'\n'  PrimaryKeyLookup owners where id = 2'\n---\n") != std::string::npos);
+        assert(output28.find("plan\n'Project owners.name, pets.kind'\n"
+                             "'  MergeJoin owners.id = pets.owner'\n'    Scan owners'\n"
+                             "'    Scan pets where kind <> 'dog' (zone maps on kind)'\n---\n") != std::string::npos);
+        assert(output28.find("'Project * (rows=2 time=") != std::string::npos);
+        assert(output28.find("'  Scan pets where owner = 2 (zone maps on owner) (rows=2 time=") != std::string::npos);
+        assert(output28.find("plan\n'Delete from pets'\n'  Scan pets where kind = 'cat' (zone maps on kind)'\n---\n") != std::string::npos);
+        assert(output28.find("'Update pets set kind = 'bird' (rows=1 time=") != std::string::npos);
+        assert(output28.find("kind\n'cat'\n'dog'\n'bird'\n---\n") != std::string::npos);
+
+        // Test 29: ANALYZE statistics steer index use, join build side and conjunct order
+        std::cout << "Test 29: ANALYZE and cost-based planning...\n";
+        {
+            HyperLogLog sketch;
+            for (int i = 0; i < 20000; i++) sketch.add(CellData(i));
+            assert(sketch.estimate() > 18000 && sketch.estimate() < 22000);
+
+            std::string load = "USE DATABASE test_db; CREATE TABLE items (id INTEGER PRIMARY KEY, kind TEXT, qty INTEGER);"
+                               "CREATE BITMAP INDEX ON items (kind); INSERT INTO items VALUES ";
+            for (int i = 0; i < 1000; i++) {
+                load += (i ? ", (" : "(") + std::to_string(i) + (i % 20 ? ", 'common', " : ", 'rare', ") + std::to_string(i % 100) + ")";
+            }
+            load += "; CREATE TABLE kinds (kind TEXT, label TEXT); INSERT INTO kinds VALUES ('common', 'C'), ('rare', 'R');";
+            SqlInterpreter interpreter;
+            interpreter.execute(load);
+            auto plan = [&](std::string sql) {
+                interpreter.execute("EXPLAIN " + sql);
+                return csv_dumps(interpreter.outputTables[0], false, true);
+            };
+            std::string common = "SELECT id FROM items WHERE kind = 'common';";
+            std::string rare = "SELECT id FROM items WHERE qty >= 10 AND kind = 'rare';";
+            assert(plan(common).find("'  BitmapLookup items where kind = 'common''") != std::string::npos);
+            assert(plan(rare).find("'  BitmapLookup items where (qty >= 10) AND (kind = 'rare')'") != std::string::npos);
+
+            interpreter.execute("ANALYZE items;");
+            assert(plan(common).find("'  Scan items where kind = 'common' (zone maps on kind)'") != std::string::npos);
+            assert(plan(rare).find("'  BitmapLookup items where (kind = 'rare') AND (qty >= 10)'") != std::string::npos);
+            std::string join = "SELECT items.id, kinds.label FROM items INNER JOIN kinds ON items.kind = kinds.kind WHERE items.id < 3;";
+            assert(plan(join).find("HashJoin items.kind = kinds.kind (build right)") != std::string::npos);
+            interpreter.execute(join);
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "items.id,kinds.label\n0,'R'\n1,'C'\n2,'C'\n");
+
+            // saved with the database and read back with it
+            interpreter.execute("USE DATABASE test_db;");
+            assert(interpreter.current_db->get_table("items").stats->analyzed);
+            assert(plan(common).find("'  Scan items where kind = 'common' (zone maps on kind)'") != std::string::npos);
+
+            // enough new rows bring the histograms up to date without another ANALYZE
+            std::string more = "INSERT INTO items VALUES ";
+            for (int i = 1000; i < 3000; i++) more += (i > 1000 ? ", (" : "(") + std::to_string(i) + ", 'rare', 1)";
+            interpreter.execute(more + ";");
+            assert(interpreter.current_db->get_table("items").stats->analyzed_rows == 3000);
+            assert(plan(common).find("'  BitmapLookup items where kind = 'common''") != std::string::npos);
+            assert(plan("SELECT id FROM items WHERE kind = 'rare';").find("'  Scan items where kind = 'rare' (zone maps on kind)'") != std::string::npos);
+
+            bool unknown_rejected = false;
+            try { interpreter.execute("ANALYZE nothing;"); } catch (const std::runtime_error&) { unknown_rejected = true; }
+            assert(unknown_rejected);
+        }
+
+        // Test 30: A star join starts from the selective dimension, whatever order it is written in
+        std::cout << "Test 30: Join order optimization...\n";
+        {
+            std::string load = "USE DATABASE test_db;"
+                               "CREATE TABLE sales (id INTEGER, store INTEGER, product INTEGER, day INTEGER, promo INTEGER);"
+                               "CREATE TABLE store (id INTEGER, city TEXT); CREATE TABLE product (id INTEGER, title TEXT);"
+                               "CREATE TABLE day (id INTEGER, weekday TEXT); CREATE TABLE promo (id INTEGER, code TEXT);"
+                               "INSERT INTO sales VALUES ";
+            for (int i = 0; i < 400; i++) {
+                load += (i ? ", (" : "(") + std::to_string(i) + ", " + std::to_string(i % 10) + ", " + std::to_string(i % 20) +
+                        ", " + std::to_string(i % 7) + ", " + std::to_string(i % 40) + ")";
+            }
+            load += ";";
+            for (auto [table, count] : {std::pair{"store", 10}, {"product", 20}, {"day", 7}, {"promo", 40}}) {
+                load += std::string("INSERT INTO ") + table + " VALUES ";
+                for (int i = 0; i < count; i++) load += (i ? ", (" : "(") + std::to_string(i) + ", 'v" + std::to_string(i) + "')";
+                load += ";";
+            }
+            SqlInterpreter interpreter;
+            interpreter.execute(load);
+            std::string star = "SELECT * FROM sales JOIN store ON sales.store = store.id JOIN product ON sales.product = product.id "
+                               "INNER JOIN day ON sales.day = day.id JOIN promo ON sales.promo = promo.id WHERE promo.code = 'v7';";
+            interpreter.execute("EXPLAIN " + star);
+            std::string plan = csv_dumps(interpreter.outputTables[0], false, true);
+            // the innermost (first) join is the fact table with the filtered dimension
+            size_t first_join = plan.rfind("HashJoin ");
+            assert(plan.compare(first_join, 33, "HashJoin sales.promo = promo.id (") == 0);
+            assert(plan.find("Scan promo where code = 'v7'") != std::string::npos);
+            assert(plan.find("NestedLoopJoin") == std::string::npos);
+            interpreter.execute(star);
+            assert(csv_dumps(interpreter.outputTables[0], false, true) ==
+                   "sales.id,sales.store,sales.product,sales.day,sales.promo,store.id,store.city,product.id,product.title,"
+                   "day.id,day.weekday,promo.id,promo.code\n"
+                   "7,7,7,0,7,7,'v7',7,'v7',0,'v0',7,'v7'\n"
+                   "47,7,7,5,7,7,'v7',7,'v7',5,'v5',7,'v7'\n"
+                   "87,7,7,3,7,7,'v7',7,'v7',3,'v3',7,'v7'\n"
+                   "127,7,7,1,7,7,'v7',7,'v7',1,'v1',7,'v7'\n"
+                   "167,7,7,6,7,7,'v7',7,'v7',6,'v6',7,'v7'\n"
+                   "207,7,7,4,7,7,'v7',7,'v7',4,'v4',7,'v7'\n"
+                   "247,7,7,2,7,7,'v7',7,'v7',2,'v2',7,'v7'\n"
+                   "287,7,7,0,7,7,'v7',7,'v7',0,'v0',7,'v7'\n"
+                   "327,7,7,5,7,7,'v7',7,'v7',5,'v5',7,'v7'\n"
+                   "367,7,7,3,7,7,'v7',7,'v7',3,'v3',7,'v7'\n");
+        }
+
+        // Test 31: A selective build side filters the probe side's scan through a bloom filter
+        std::cout << "Test 31: Bloom filter join pushdown...\n";
+        {
+            BloomFilter filter(1000);
+            for (int i = 0; i < 1000; i++) filter.add(CellData(i * 2));
+            int false_positives = 0;
+            for (int i = 0; i < 1000; i++) {
+                assert(filter.may_contain(CellData(i * 2)));
+                assert(filter.may_contain(CellData(double(i * 2))));  // equal values, equal bits
+                if (filter.may_contain(CellData(i * 2 + 1))) false_positives++;
+            }
+            assert(false_positives < 50);
+
+            std::string load = "USE DATABASE test_db; CREATE TABLE pupils (id INTEGER PRIMARY KEY, year INTEGER);"
+                               "CREATE TABLE signups (pupil INTEGER, course INTEGER); INSERT INTO pupils VALUES ";
+            for (int i = 0; i < 100; i++) load += (i ? ", (" : "(") + std::to_string(i) + ", " + std::to_string(i % 10) + ")";
+            load += "; INSERT INTO signups VALUES ";
+            for (int i = 0; i < 2000; i++) load += (i ? ", (" : "(") + std::to_string(i % 100) + ", " + std::to_string(i) + ")";
+            SqlInterpreter interpreter;
+            interpreter.execute(load + ";");
+            std::string query = "SELECT signups.course FROM signups JOIN pupils ON signups.pupil = pupils.id "
+                                "WHERE pupils.year = 3 AND signups.course < 400;";
+            interpreter.execute("EXPLAIN ANALYZE " + query);
+            std::string plan = csv_dumps(interpreter.outputTables[0], false, true);
+            // 10 of the 100 pupils qualify, so about a tenth of the signups survive the scan
+            size_t scan = plan.find("Scan signups where course < 400 (zone maps on course) (bloom filter on pupil) (rows=");
+            assert(scan != std::string::npos);
+            assert(std::stoi(plan.substr(plan.find("rows=", scan) + 5)) < 80);
+            interpreter.execute(query);
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "signups.course\n3\n13\n23\n33\n43\n53\n63\n73\n83\n93\n"
+                                                                        "103\n113\n123\n133\n143\n153\n163\n173\n183\n193\n"
+                                                                        "203\n213\n223\n233\n243\n253\n263\n273\n283\n293\n"
+                                                                        "303\n313\n323\n333\n343\n353\n363\n373\n383\n393\n");
+        }
+
+        // Test 32: Inputs already in key order, or too big to hash, are merge joined
+        std::cout << "Test 32: Sort-merge join...\n";
+        {
+            SqlInterpreter interpreter;
+            interpreter.execute("USE DATABASE test_db; CREATE TABLE days (day INTEGER, name TEXT);"
+                                "CREATE TABLE shifts (day INTEGER, worker TEXT);"
+                                "INSERT INTO days VALUES (1, 'mon'), (2, 'tue'), (2, 'tue2'), (4, 'thu');"
+                                "INSERT INTO shifts VALUES (0, 'zed'), (2, 'amy'), (2, 'bo'), (3, 'cy'), (4, 'di');");
+            std::string query = "SELECT days.name, shifts.worker FROM days JOIN shifts ON days.day = shifts.day;";
+            interpreter.execute("EXPLAIN " + query);
+            assert(csv_dumps(interpreter.outputTables[0], false, true).find("'  MergeJoin days.day = shifts.day'") != std::string::npos);
+            auto prepared = interpreter.prepare(query);
+            interpreter.execute(*prepared);
+            std::string joined = "days.name,shifts.worker\n'tue','amy'\n'tue','bo'\n'tue2','amy'\n'tue2','bo'\n'thu','di'\n";
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == joined);
+
+            // out of order: hashed within the memory budget, past it merged after sorting, in key order
+            interpreter.execute("INSERT INTO days VALUES (0, 'sun'); INSERT INTO shifts VALUES (1, 'eve');");
+            std::string sorted = "days.name,shifts.worker\n'sun','zed'\n'mon','eve'\n'tue','amy'\n'tue','bo'\n"
+                                 "'tue2','amy'\n'tue2','bo'\n'thu','di'\n";
+            interpreter.execute(*prepared);  // still the merge join planned while the tables were sorted
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == sorted);
+            interpreter.execute("EXPLAIN " + query);
+            assert(csv_dumps(interpreter.outputTables[0], false, true).find("HashJoin") != std::string::npos);
+            interpreter.execute(query);
+            std::string hashed = csv_dumps(interpreter.outputTables[0], false, true);
+            assert(hashed == "days.name,shifts.worker\n'mon','eve'\n'tue','amy'\n'tue','bo'\n'tue2','amy'\n'tue2','bo'\n"
+                             "'thu','di'\n'sun','zed'\n");
+            interpreter.join_memory_budget = 0;
+            interpreter.execute("EXPLAIN " + query);
+            assert(csv_dumps(interpreter.outputTables[0], false, true).find("'  MergeJoin days.day = shifts.day'") != std::string::npos);
+            interpreter.execute(query);
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == sorted);
+        }
+
+        // Test 33: IN lists probe a set once per row; DISTINCT drops repeated rows
+        std::cout << "Test 33: IN lists and SELECT DISTINCT...\n";
+        {
+            ValueSet few({CellData(3), CellData(1.5), CellData(std::string("x"))});
+            assert(few.contains(CellData(3.0)) && few.contains(CellData(1.5)) && !few.contains(CellData(2)));
+            assert(few.contains(CellData(std::string("3"))) && few.contains(CellData(std::string("x"))));
+            std::vector<CellData> many;
+            for (int i = 0; i < 300; i += 3) many.push_back(CellData(i));
+            ValueSet hashed(many);
+            assert(hashed.sorted.empty() && hashed.contains(CellData(297)) && !hashed.contains(CellData(298)));
+
+            SqlInterpreter interpreter;
+            std::string load = "USE DATABASE test_db; CREATE TABLE visits (id INTEGER, page TEXT); INSERT INTO visits VALUES ";
+            for (int i = 0; i < 60; i++) {
+                load += (i ? ", (" : "(") + std::to_string(i) + ", 'p" + std::to_string(i % 4) + "')";
+            }
+            interpreter.execute(load + ";");
+            std::string ids = "0";
+            for (int i = 5; i < 1000; i += 5) ids += ", " + std::to_string(i);
+            interpreter.execute("SELECT id FROM visits WHERE id IN (" + ids + ") AND id > 40;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "id\n45\n50\n55\n");
+            interpreter.execute("SELECT id FROM visits WHERE page NOT IN ('p0', 'p1', 'p2') AND id < 12;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "id\n3\n7\n11\n");
+            // IN is lexed as a keyword, so a column may still be called `in`
+            interpreter.execute("CREATE TABLE gates (in INTEGER); INSERT INTO gates VALUES (1), (2), (3);"
+                                "SELECT in FROM gates WHERE in NOT IN (2);");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "in\n1\n3\n");
+            interpreter.execute("SELECT id FROM visits WHERE id = 1 OR id = 2 OR id = 30 OR page = 'p9';");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "id\n1\n2\n30\n");
+
+            interpreter.execute("SELECT DISTINCT page FROM visits WHERE id IN (7, 2, 3, 6, -1);");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "page\n'p2'\n'p3'\n");
+            interpreter.execute("EXPLAIN SELECT DISTINCT page FROM visits WHERE id IN (1, 2);");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) ==
+                   "plan\n'Distinct'\n'  Project page'\n'    Scan visits where id IN (1, 2)'\n");
+        }
+
+        // Test 34: Uncorrelated subqueries run once, as hash semi-joins and anti-joins
+        std::cout << "Test 34: IN and EXISTS subqueries...\n";
+        {
+            SqlInterpreter interpreter;
+            interpreter.execute("USE DATABASE test_db;"
+                                "CREATE TABLE learners (id INTEGER PRIMARY KEY, name TEXT);"
+                                "CREATE TABLE classes (code INTEGER, dept TEXT);"
+                                "CREATE TABLE takes (student INTEGER, course INTEGER);"
+                                "INSERT INTO learners VALUES (1, 'ada'), (2, 'bob'), (3, 'cy'), (4, 'dee');"
+                                "INSERT INTO classes VALUES (10, 'math'), (11, 'math'), (20, 'art');"
+                                "INSERT INTO takes VALUES (1, 10), (2, 20), (3, 11), (3, 20), (1, 11);");
+            std::string math = "SELECT name FROM learners WHERE id IN (SELECT student FROM takes WHERE course IN "
+                               "(SELECT code FROM classes WHERE dept = 'math'))";
+            interpreter.execute(math + ";");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "name\n'ada'\n'cy'\n");
+            interpreter.execute("EXPLAIN " + math + " AND id > 1;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) ==
+                   "plan\n'Project name'\n'  HashSemiJoin id'\n'    Scan learners where id > 1 (zone maps on id)'\n"
+                   "'    Project student'\n'      HashSemiJoin course'\n'        Scan takes'\n"
+                   "'        Project code'\n'          Scan classes where dept = 'math' (zone maps on dept)'\n");
+            interpreter.execute("SELECT name FROM learners WHERE id NOT IN (SELECT student FROM takes);");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "name\n'dee'\n");
+            interpreter.execute("SELECT name FROM learners WHERE id < 3 AND EXISTS (SELECT code FROM classes WHERE dept = 'art');");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "name\n'ada'\n'bob'\n");
+            interpreter.execute("SELECT name FROM learners WHERE NOT EXISTS (SELECT code FROM classes WHERE dept = 'law');");
+            assert(interpreter.outputTables[0].rows->size() == 4);
+            interpreter.execute("CREATE TABLE flags (exists INTEGER); INSERT INTO flags VALUES (0), (1);"
+                                "SELECT exists FROM flags WHERE exists = 1 AND EXISTS (SELECT exists FROM flags);");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "exists\n1\n");
+
+            interpreter.execute("DELETE FROM takes WHERE course IN (SELECT code FROM classes WHERE dept = 'art');");
+            interpreter.execute("SELECT student FROM takes;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "student\n1\n3\n1\n");
+            bool threw = false;
+            try {
+                interpreter.execute("SELECT name FROM learners WHERE id = 4 OR id IN (SELECT student FROM takes);");
+            } catch (const std::runtime_error&) {
+                threw = true;
+            }
+            assert(threw);
+            // a subquery reading the outer query's columns is refused instead of seeing zeros
+            for (std::string correlated : {"takes.student = learners.id", "student = id"}) {
+                std::string error;
+                try {
+                    interpreter.execute("SELECT name FROM learners WHERE EXISTS (SELECT * FROM takes WHERE " + correlated + ");");
+                } catch (const std::runtime_error& e) {
+                    error = e.what();
+                }
+                assert(error.find("correlated subqueries are not supported") != std::string::npos);
+            }
+        }
+
+        // Test 35: Query results go straight into tables
+        std::cout << "Test 35: INSERT INTO ... SELECT and CREATE TABLE AS SELECT...\n";
+        {
+            SqlInterpreter interpreter;
+            interpreter.execute("USE DATABASE test_db;"
+                                "CREATE TABLE tills (shop INTEGER, amount DECIMAL(8,2));"
+                                "CREATE TABLE stores (id INTEGER PRIMARY KEY, city TEXT);"
+                                "INSERT INTO tills VALUES (1, 2.50), (2, 10), (1, 0.25);"
+                                "INSERT INTO stores VALUES (1, 'oslo'), (2, 'rome');"
+                                "CREATE TABLE big_tills (shop BIGINT, amount FLOAT);"
+                                "INSERT INTO big_tills SELECT shop, amount FROM tills WHERE amount > 1;");
+            interpreter.execute("SELECT * FROM big_tills;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "shop,amount\n1,2.50\n2,10.00\n");
+
+            interpreter.execute("CREATE TABLE digest AS SELECT stores.city, tills.amount, stores.id FROM tills "
+                                "JOIN stores ON tills.shop = stores.id WHERE stores.city = 'oslo';");
+            auto& digest = interpreter.current_db->get_table("digest");
+            assert(digest.schema.elements[0].name == "city" && digest.schema.elements[2].name == "id");
+            assert(digest.schema.elements[1].value == DataType::DECIMAL && digest.decimal_spec(1).scale == 2);
+            interpreter.execute("SELECT city, amount FROM digest WHERE id = 1;");
+            assert(csv_dumps(interpreter.outputTables[0], false, true) == "city,amount\n'oslo',2.50\n'oslo',0.25\n");
+            interpreter.execute("CREATE TABLE couples AS SELECT * FROM stores JOIN big_tills ON stores.id = big_tills.shop;");
+            auto& couples = interpreter.current_db->get_table("couples");
+            assert(couples.schema.elements[0].name == "id" && couples.schema.elements[1].name == "city");
+            assert(couples.rows->size() == 2);
+
+            // checked against the target's schema: nothing is added when a row doesn't fit
+            interpreter.execute("CREATE TABLE tiny (amount DECIMAL(2,1));");
+            bool threw = false;
+            try {
+                interpreter.execute("INSERT INTO tiny SELECT amount FROM tills;");
+            } catch (const std::runtime_error&) {
+                threw = true;
+            }
+            assert(threw);
+            threw = false;
+            try {
+                interpreter.execute("INSERT INTO stores SELECT shop, amount FROM tills;");
+            } catch (const std::runtime_error&) {
+                threw = true;
+            }
+            assert(threw && interpreter.current_db->get_table("stores").rows->size() == 2);
+        }
+
         cleanup_test_files();
         std::cout << "All main()-based tests passed successfully!\n";
         
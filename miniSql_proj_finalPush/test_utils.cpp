@@ -25,8 +25,11 @@ bool file_exists(const std::string& filename) {
 void cleanup_test_files() {
     std::filesystem::remove_all("./dbs/test_db");
     std::filesystem::remove_all("./dbs/db_university");
-    for (int i = 1; i <= 10; i++) {
+    for (int i = 1; i <= 35; i++) {
         std::filesystem::remove("test" + std::to_string(i) + ".sql");
         std::filesystem::remove("test" + std::to_string(i) + "_output.txt");
     }
+    std::filesystem::remove("test22_import.csv");
+    std::filesystem::remove("test22_export.csv");
+    std::filesystem::remove("test27_output.txt.stats.json");
 }
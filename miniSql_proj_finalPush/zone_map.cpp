@@ -0,0 +1,37 @@
+#include "zone_map.hpp"
+
+void ZoneMap::add(CellData value, DataType column_type) {
+    include(value, column_type);
+    rows++;
+}
+
+void ZoneMap::include(CellData value, DataType column_type) {
+    // text and numbers compare differently, so a mixed column has no usable range
+    if ((value.type == DataType::TEXT) != (column_type == DataType::TEXT)) ordered = false;
+    if (rows == 0) {
+        min = value;
+        max = value;
+        return;
+    }
+    if (value < min) min = value;
+    if (value > max) max = value;
+}
+
+void ZoneMap::merge(const ZoneMap& other) {
+    if (other.rows == 0) return;
+    if (!other.ordered) ordered = false;
+    if (other.min < min) min = other.min;
+    if (other.max > max) max = other.max;
+}
+
+bool ZoneMap::may_match(std::string op, CellData value) const {
+    if (rows == 0) return false;
+    if (!ordered) return true;
+    if (op == "=") return !(value < min) && !(value > max);
+    if (op == "<") return min < value;
+    if (op == ">") return max > value;
+    if (op == "<=") return !(min > value);
+    if (op == ">=") return !(max < value);
+    if (op == "<>") return min < value || min > value || max < value || max > value;
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef ZONE_MAP_H
+#define ZONE_MAP_H
+
+#include "celldata.hpp"
+
+// Min/max summary of one column over one block of rows. A block whose range
+// cannot satisfy `column <op> value` is skipped without looking at its rows.
+class ZoneMap {
+public:
+    CellData min;
+    CellData max;
+    size_t rows = 0;
+    bool ordered = true;  // cleared once a value of another type family shows up
+
+    void add(CellData value, DataType column_type);
+    void include(CellData value, DataType column_type);  // widen without counting a row
+    void merge(const ZoneMap& other);  // widen to cover `other` too; rows stay as they are
+    bool may_match(std::string op, CellData value) const;
+};
+
+#endif